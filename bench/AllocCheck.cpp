@@ -0,0 +1,188 @@
+//Allocation check for the client's snapshot handling, no server needed.
+//Replaces the global operator new with one that counts, then feeds the
+//client path everything it gets from the server in a game: 'D' and 'Q'
+//deltas decoded against the snapshot history, 'S' messages, applied to the
+//ship list with ShipUpdater and recorded for interpolation and prediction.
+//After a warm-up (buffers growing to size, every ship seen once) the same
+//ships keep flying around and not one allocation should happen. For
+//comparison it also counts the old way, rebuilding the list from new Ships.
+//Exits non-zero if the steady state allocates.
+//
+//usage: allocCheck [ships] [snapshots]
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <random>
+#include "../src/Ship.h"
+#include "../src/Protocol.h"
+#include "../src/Snapshot.h"
+#include "../src/ShipView.h"
+#include "../src/Movement.h"
+#include "../src/Interpolation.h"
+#include "../src/Prediction.h"
+
+using namespace std;
+
+static atomic<long> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if(p == NULL)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+// What the network thread keeps between messages
+struct Client
+{
+    Snapshot history[SNAPSHOT_HISTORY];
+    Snapshot next;
+    ShipUpdater updater;
+    Interpolator interpolator;
+    Prediction prediction{BOARD_COLS, BOARD_ROWS};
+    vector<Ship*> ships;
+    int cid = 0;
+
+    bool Apply(const string& message)
+    {
+        if(message[0] == 'S')
+        {
+            SnapshotView view;
+            if(!view.Parse(message.data(), message.size()))
+                return false;
+            updater.Apply(view, ships);
+            return true;
+        }
+
+        int base = Snapshot::BaseSequence(message.data());
+        if(!next.DecodeDelta(message.data(), message.size(), base < 0 ? NULL : &history[base % SNAPSHOT_HISTORY]))
+            return false;
+        Snapshot& applied = history[next.getSequence() % SNAPSHOT_HISTORY];
+        swap(applied, next);
+        updater.Apply(SnapshotView(applied), ships);
+        interpolator.Record(ships);
+        for(int i = 0; i < ships.size(); i++)
+        {
+            if(ships[i]->getID() == cid)
+                prediction.Reconcile(ships[i], applied.getSequence());
+        }
+        return true;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    int numShips = argc >= 2 ? atoi(argv[1]) : 100;
+    int numSnapshots = argc >= 3 ? atoi(argv[2]) : 3000;
+    int warmup = SNAPSHOT_HISTORY * 2;
+    if(numShips <= 0 || numSnapshots <= warmup)
+    {
+        cerr << "usage: allocCheck [ships] [snapshots > " << warmup << "]\n";
+        return 1;
+    }
+
+    // Everything the server would send, made up front so only the client is counted:
+    // deltas against the previous snapshot, alternating formats, and every
+    // so often a whole 'S' as well
+    mt19937 rng(1);
+    vector<Ship*> fleet;
+    for(int i = 0; i < numShips; i++)
+    {
+        int shields[4] = {20, 15, 15, 10};
+        Ship* ship = new Ship(i, 6, AVERAGE, 14, 5, 10, 5, 100, 40, shields);
+        ship->setXpos(rng() % BOARD_COLS);
+        ship->setYpos(rng() % BOARD_ROWS);
+        ship->setOwner(i);
+        fleet.push_back(ship);
+    }
+    vector<Snapshot> snapshots;
+    vector<string> messages;
+    snapshots.reserve(numSnapshots);
+    messages.reserve(numSnapshots * 2);
+    for(int s = 0; s < numSnapshots; s++)
+    {
+        for(int i = 0; i < numShips; i++)
+        {
+            if(rng() % 4 == 0)
+                Movement::Apply(fleet[i], 1 << (rng() % 3), BOARD_COLS, BOARD_ROWS);
+        }
+        snapshots.push_back(Snapshot(s + 1, fleet));
+        string message;
+        if(s % 2)
+            snapshots[s].EncodePacked(s == 0 ? NULL : &snapshots[s - 1], message);
+        else
+            snapshots[s].EncodeDelta(s == 0 ? NULL : &snapshots[s - 1], message);
+        messages.push_back(message);
+        if(s % 50 == 49)
+        {
+            Protocol::CrunchetizeMeCapn(-1, fleet, message);
+            messages.push_back(message);
+        }
+    }
+
+    Client client;
+    for(int s = 0; s < warmup; s++)
+        client.Apply(messages[s]);
+
+    long before = allocations;
+    for(int s = warmup; s < messages.size(); s++)
+    {
+        if(!client.Apply(messages[s]))
+        {
+            cerr << "message " << s << " did not apply\n";
+            return 1;
+        }
+    }
+    long steady = allocations - before;
+
+    // The ship list must match what was sent
+    const Snapshot& last = snapshots.back();
+    bool same = (int)client.ships.size() == last.getShipCount();
+    for(int i = 0; same && i < last.getShipCount(); i++)
+    {
+        int record[SHIP_INTS];
+        Protocol::PackShip(client.ships[i], record);
+        same = memcmp(record, last.getRecord(i), sizeof(record)) == 0;
+    }
+    if(!same)
+    {
+        cerr << "ship list does not match the last snapshot\n";
+        return 1;
+    }
+
+    // The old way: a new Ship for every ship in every snapshot
+    vector<Ship*> rebuilt;
+    before = allocations;
+    for(int s = warmup; s < numSnapshots; s++)
+    {
+        for(int i = 0; i < rebuilt.size(); i++)
+            delete rebuilt[i];
+        rebuilt.clear();
+        snapshots[s].ToShips(rebuilt);
+    }
+    long old = allocations - before;
+
+    int measured = messages.size() - warmup;
+    printf("%d ships, %d messages after %d to warm up\n", numShips, measured, warmup);
+    printf("allocations per message: %.2f patching in place, %.2f rebuilding\n",
+        (double)steady / measured, (double)old / (numSnapshots - warmup));
+    if(steady != 0)
+    {
+        printf("FAIL: %ld allocations in the steady state\n", steady);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
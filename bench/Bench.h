@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_MIN_MS 200        // each benchmark repeats until it has run this long
+#define BENCH_QUICK_MS 20       // with --quick
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"  // the makefile passes in the current commit
+#endif
+
+// Shared by the `make bench` programs. Every result is one JSON object on a
+// line of its own, so runs can be saved and compared line by line:
+//   {"commit":"1a2b3c4","suite":"protocol","bench":"crunch","n":1000,
+//    "iterations":5120,"ns_per_op":25101.3,"items_per_s":39838890,"bytes":72013}
+// n is how many items (ships, projectiles, clients, hexes) one op handles,
+// and bytes the size of the message it makes or reads, -1 if none.
+//
+// usage: <bench> [--quick] [--filter TEXT]
+//   --quick         shorter runs, for checking the harness rather than numbers
+//   --filter TEXT   only benchmarks whose suite/bench name contains TEXT
+
+namespace Bench
+{
+    static int minMs = BENCH_MIN_MS;
+    static const char* filter = NULL;
+
+    inline void Init(int argc, char* argv[])
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            if(strcmp(argv[i], "--quick") == 0)
+                minMs = BENCH_QUICK_MS;
+            else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+                filter = argv[++i];
+            else
+            {
+                fprintf(stderr, "usage: %s [--quick] [--filter TEXT]\n", argv[0]);
+                exit(1);
+            }
+        }
+    }
+
+    inline bool Wanted(const char* suite, const char* bench)
+    {
+        if(filter == NULL)
+            return true;
+        std::string name = std::string(suite) + "/" + bench;
+        return name.find(filter) != std::string::npos;
+    }
+
+    // Stops the compiler from dropping work whose result is never used
+    template<class T>
+    inline void KeepAlive(const T& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // Runs op in growing batches until minMs have gone by, then prints the
+    // result line. op is called once first to warm up caches and buffers
+    template<class Op>
+    void Run(const char* suite, const char* bench, long n, long bytes, Op op)
+    {
+        typedef std::chrono::steady_clock Clock;
+        if(!Wanted(suite, bench))
+            return;
+        op();
+
+        long iterations = 0;
+        long batch = 1;
+        double elapsedNs = 0;
+        Clock::time_point start = Clock::now();
+        while(elapsedNs < minMs * 1e6)
+        {
+            for(long i = 0; i < batch; i++)
+                op();
+            iterations += batch;
+            elapsedNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            if(batch < (1 << 20))
+                batch *= 2;
+        }
+
+        double nsPerOp = elapsedNs / iterations;
+        printf("{\"commit\":\"%s\",\"suite\":\"%s\",\"bench\":\"%s\",\"n\":%ld,\"iterations\":%ld,"
+            "\"ns_per_op\":%.1f,\"items_per_s\":%.0f,\"bytes\":%ld}\n",
+            BENCH_COMMIT, suite, bench, n, iterations, nsPerOp, n * 1e9 / nsPerOp, bytes);
+        fflush(stdout);
+    }
+}
+
+#endif
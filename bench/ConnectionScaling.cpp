@@ -0,0 +1,305 @@
+//Connection-count scaling benchmark for the server.
+//Opens a growing number of idle spectator connections against a running server and
+//measures the ship-update round trip seen by one active client at each step.
+//With the epoll loop the round trip should stay flat as idle connections are added;
+//only the broadcast fan-out grows with the client count.
+//
+//With "udp" the active client takes its snapshots by datagram. Lost ones are
+//retried by sending the update again, so the percentiles show what loss costs;
+//run the server with --udp --udp-drop N to try it on loopback
+//
+//usage: connectionBench [host] [port] [max connections] [rounds per step] [session] [tcp|udp]
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "../src/Ship.h"
+#include "../src/Protocol.h"
+#include "../src/RingBuffer.h"
+#include "../src/Snapshot.h"
+
+using namespace std;
+
+int Connect(const char* host, int port, int session)
+{
+    struct hostent* he = gethostbyname(host);
+    if(he == NULL)
+        return -1;
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
+    addr.sin_port = htons(port);
+
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if(sd < 0)
+        return -1;
+    if(connect(sd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(sd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // Handshake: join the session, the server answers with our client ID
+    char join[sizeof(char) + sizeof(int)];
+    join[0] = 'C';
+    memcpy(&join[sizeof(char)], &session, sizeof(int));
+    send(sd, join, sizeof(join), 0);
+    return sd;
+}
+
+// UDP side of the active client, udpSd < 0 when everything is on TCP
+int udpSd = -1;
+int udpToken = -1;
+int newest = -1;    // sequence of the newest snapshot seen on either channel
+
+// Acknowledges a snapshot on whichever channel carries them
+void Ack(int sd, int sequence)
+{
+    if(udpSd >= 0)
+    {
+        char ack[sizeof(char) + 2 * sizeof(int)];
+        ack[0] = 'A';
+        memcpy(&ack[sizeof(char)], &udpToken, sizeof(int));
+        memcpy(&ack[sizeof(char) + sizeof(int)], &sequence, sizeof(int));
+        send(udpSd, ack, sizeof(ack), 0);
+        return;
+    }
+    char ack[sizeof(char) + sizeof(int)];
+    ack[0] = 'A';
+    memcpy(&ack[sizeof(char)], &sequence, sizeof(int));
+    send(sd, ack, sizeof(ack), 0);
+}
+
+// Waits up to timeoutMs (-1 = forever) for a snapshot newer than the last one,
+// acknowledges it and returns its size; 0 on timeout, -1 if the server went away
+int ReadSnapshot(int sd, RingBuffer& in, int timeoutMs)
+{
+    while(true)
+    {
+        int length;
+        const char* msg;
+        while((msg = Protocol::NextMessage(in, length)) != NULL)
+        {
+            char type = msg[0];
+            int sequence = type == 'D' ? Snapshot::Sequence(msg) : -1;
+            in.Consume(length);
+            if(type != 'D' || sequence <= newest)
+                continue;
+            newest = sequence;
+            Ack(sd, sequence);
+            return length;
+        }
+        if(length < 0)
+            return -1;
+
+        struct pollfd fds[2] = {{sd, POLLIN, 0}, {udpSd, POLLIN, 0}};
+        int ready = poll(fds, udpSd >= 0 ? 2 : 1, timeoutMs);
+        if(ready == 0)
+            return 0;
+        if(ready < 0)
+            return -1;
+        if(udpSd >= 0 && (fds[1].revents & POLLIN))
+        {
+            char datagram[UDP_MAX_PAYLOAD];
+            int got = recv(udpSd, datagram, sizeof(datagram), 0);
+            // Older than what we have, or a leftover from a round we gave up on
+            if(got > 0 && Protocol::FrameLength(datagram, got) == got && datagram[0] == 'D'
+                && Snapshot::Sequence(datagram) > newest)
+            {
+                newest = Snapshot::Sequence(datagram);
+                Ack(sd, newest);
+                return got;
+            }
+        }
+        if((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && in.ReadFrom(sd) <= 0)
+            return -1;
+    }
+}
+
+// Asks for snapshots by UDP and says hello from the socket they should go to
+bool OpenUdp(int sd, const char* host, RingBuffer& in)
+{
+    char request[sizeof(char) + 2 * sizeof(int)] = {'U'};
+    send(sd, request, sizeof(request), 0);
+
+    int length;
+    const char* msg;
+    while((msg = Protocol::NextMessage(in, length)) == NULL || msg[0] != 'U')
+    {
+        if(msg != NULL)
+            in.Consume(length);
+        else if(length < 0 || in.ReadFrom(sd) <= 0)
+            return false;
+    }
+    int port;
+    memcpy(&port, &msg[sizeof(char)], sizeof(int));
+    memcpy(&udpToken, &msg[sizeof(char) + sizeof(int)], sizeof(int));
+    in.Consume(length);
+    if(port == 0)
+        return false;
+
+    struct hostent* he = gethostbyname(host);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
+    addr.sin_port = htons(port);
+    udpSd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(udpSd < 0 || connect(udpSd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        return false;
+
+    // Said a few times, it is a datagram too
+    char hello[sizeof(char) + sizeof(int)];
+    hello[0] = 'U';
+    memcpy(&hello[sizeof(char)], &udpToken, sizeof(int));
+    for(int i = 0; i < 3; i++)
+    {
+        send(udpSd, hello, sizeof(hello), 0);
+        usleep(10000);
+    }
+    return true;
+}
+
+bool ReadExactly(int sd, char* buf, int len)
+{
+    while(len > 0)
+    {
+        int got = read(sd, buf, len);
+        if(got <= 0)
+            return false;
+        buf += got;
+        len -= got;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* host = argc > 1 ? argv[1] : "localhost";
+    int port = argc > 2 ? atoi(argv[2]) : 8081;
+    int maxConnections = argc > 3 ? atoi(argv[3]) : 4000;
+    int rounds = argc > 4 ? atoi(argv[4]) : 200;
+    int session = argc > 5 ? atoi(argv[5]) : 0;
+    bool udp = argc > 6 && strcmp(argv[6], "udp") == 0;
+
+    struct rlimit lim;
+    if(getrlimit(RLIMIT_NOFILE, &lim) == 0)
+    {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // The active client connects first so it is client 0 and owns ship 0
+    int active = Connect(host, port, session);
+    if(active < 0)
+    {
+        perror("connect");
+        return 1;
+    }
+    char idMsg[sizeof(char) + sizeof(int)];
+    if(!ReadExactly(active, idMsg, sizeof(idMsg)))
+        return 1;
+    int cid = Protocol::ParseClientIDMessage(idMsg, sizeof(idMsg));
+    RingBuffer in;
+    if(udp && !OpenUdp(active, host, in))
+    {
+        cerr << "server would not send snapshots by UDP (run it with --udp)\n";
+        return 1;
+    }
+
+    // The server takes our ship from index cid of whatever list we upload
+    vector<Ship*> ships;
+    while((int)ships.size() < cid)
+        ships.push_back(new Ship());
+    Ship* shp = new Ship();
+    shp->setID(cid);
+    shp->setOwner(cid);
+    ships.push_back(shp);
+
+    vector<int> idle;
+    string msg;
+    printf("%12s %12s %12s %12s %12s %12s %12s\n", "connections", "connect_ms", "rtt_avg_us", "rtt_p50_us", "rtt_p99_us", "reply_bytes", "retries");
+
+    int target = 0;
+    while(true)
+    {
+        auto connectStart = chrono::steady_clock::now();
+        while((int)idle.size() < target)
+        {
+            int sd = Connect(host, port, session);
+            if(sd < 0)
+            {
+                perror("connect");
+                break;
+            }
+            idle.push_back(sd);
+        }
+        double connectMs = chrono::duration<double, milli>(chrono::steady_clock::now() - connectStart).count();
+
+        vector<double> rtts;
+        long replyBytes = 0;
+        int retries = 0;
+        for(int r = 0; r < rounds; r++)
+        {
+            shp->setXpos(r % 100);
+            Protocol::CrunchetizeMeCapn(cid, ships, msg);
+
+            // Only the active client uploads, so every upload comes back as one
+            // broadcast. A datagram can go missing, then the update goes again
+            auto start = chrono::steady_clock::now();
+            int reply = 0;
+            while(reply == 0)
+            {
+                if(send(active, msg.data(), msg.size(), 0) != (ssize_t)msg.size())
+                {
+                    perror("send");
+                    return 1;
+                }
+                reply = ReadSnapshot(active, in, udp ? 20 : -1);
+                if(reply == 0)
+                    retries++;
+            }
+            if(reply < 0)
+            {
+                cerr << "server closed the connection\n";
+                return 1;
+            }
+            replyBytes += reply;
+            rtts.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        }
+
+        sort(rtts.begin(), rtts.end());
+        double sum = 0;
+        for(int i = 0; i < rtts.size(); i++)
+            sum += rtts[i];
+        printf("%12d %12.1f %12.1f %12.1f %12.1f %12.1f %12d\n", (int)idle.size(), connectMs,
+            sum / rtts.size(), rtts[rtts.size() / 2], rtts[(rtts.size() * 99) / 100], (double)replyBytes / rounds, retries);
+        fflush(stdout);
+
+        if(target >= maxConnections || (int)idle.size() < target)
+            break;
+        target = min(target == 0 ? 10 : target * 2, maxConnections);
+    }
+
+    for(int i = 0; i < idle.size(); i++)
+        close(idle[i]);
+    close(active);
+    if(udpSd >= 0)
+        close(udpSd);
+    for(int i = 0; i < ships.size(); i++)
+        delete ships[i];
+    return 0;
+}
@@ -0,0 +1,86 @@
+//Hex grid microbenchmarks for `make bench` (needs SFML for the vertex types).
+//  hexgrid: offset/pixel conversions, 10000 per op, and GenerateHexGrid and
+//           GenerateHexChunks for boards from 10x10 to the 100x100 the game
+//           draws, and a 1000x1000 one, big enough for the threaded fill
+//  sprites: 10000 ships placed and batched into one vertex array, the way
+//           GameScreen::DrawShips fills its SpriteBatch each frame
+//Results are JSON lines, see Bench.h.
+#include <vector>
+#include <random>
+#include "Bench.h"
+#include "../src/HexGrid.h"
+#include "../src/SpriteBatch.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    Bench::Init(argc, argv);
+
+    // The same grid GameScreen uses
+    HexGrid grid(0, 0, 100, 100, 20, sf::LinesStrip);
+    int n = 10000;
+    mt19937 rng(1);
+    vector<sf::Vector2f> offsets;
+    vector<sf::Vector2f> pixels;
+    for(int i = 0; i < n; i++)
+    {
+        offsets.push_back(sf::Vector2f(rng() % 100, rng() % 100));
+        pixels.push_back(grid.offset_to_pixel(offsets.back()));
+    }
+
+    Bench::Run("hexgrid", "offset_to_pixel", n, -1, [&]()
+    {
+        sf::Vector2f sum;
+        for(int i = 0; i < n; i++)
+            sum += grid.offset_to_pixel(offsets[i]);
+        Bench::KeepAlive(sum);
+    });
+
+    Bench::Run("hexgrid", "pixel_to_offset", n, -1, [&]()
+    {
+        sf::Vector2f sum;
+        for(int i = 0; i < n; i++)
+            sum += grid.pixel_to_offset(pixels[i]);
+        Bench::KeepAlive(sum);
+    });
+
+    int sizes[] = {10, 50, 100, 1000};
+    for(int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int side = sizes[s];
+        HexGrid board(0, 0, side, side, 20, sf::LinesStrip);
+        Bench::Run("hexgrid", "generate", side * side, -1, [&]()
+        {
+            sf::VertexArray vertices = board.GenerateHexGrid();
+            Bench::KeepAlive(vertices);
+        });
+        Bench::Run("hexgrid", "generate_chunks", side * side, -1, [&]()
+        {
+            vector<HexChunk> chunks = board.GenerateHexChunks();
+            Bench::KeepAlive(chunks);
+        });
+    }
+
+    // Texture rects as the atlas would hand them out; no texture is needed to batch
+    vector<sf::Sprite> sprites(n);
+    for(int i = 0; i < n; i++)
+    {
+        sprites[i].setTextureRect(sf::IntRect((i % 8) * 97, 0, 96, 96));
+        sprites[i].setOrigin(48, 48);
+        sprites[i].setScale(0.4, 0.4);
+    }
+    SpriteBatch batch;
+    Bench::Run("sprites", "batch", n, -1, [&]()
+    {
+        batch.Clear();
+        for(int i = 0; i < n; i++)
+        {
+            sprites[i].setPosition(grid.offset_to_pixel(offsets[i]));
+            sprites[i].setRotation(60.0 * (i % 6));
+            batch.Add(sprites[i]);
+        }
+        Bench::KeepAlive(batch);
+    });
+    return 0;
+}
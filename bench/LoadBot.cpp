@@ -0,0 +1,501 @@
+//Headless load generator for the server.
+//Connects any number of simulated players, each doing the 'C' handshake, then
+//flying around with scripted random moves: every update waits for the server's
+//snapshot to show it (or a second to pass) and a think time before the next.
+//Prints throughput and round-trip percentiles once a second and a summary at
+//the end, one line per interval so runs can be diffed against each other.
+//The bots need CPU too: for capacity numbers run them on other cores (taskset)
+//or another machine than the server.
+//
+//usage: loadBot [--host H] [--port P] [--bots N] [--seconds S] [--rate HZ]
+//               [--sessions K] [--threads T] [--spread HEXES] [--full-state]
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/tcp.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <atomic>
+#include "../src/Ship.h"
+#include "../src/Protocol.h"
+#include "../src/RingBuffer.h"
+#include "../src/EventLoop.h"
+#include "../src/Snapshot.h"
+#include "../src/Movement.h"
+
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+#define UPDATE_TIMEOUT_MS 1000      // give up waiting to see an update after this
+
+struct Options
+{
+    const char* host = "localhost";
+    int port = 8081;
+    int bots = 1000;
+    int seconds = 10;
+    double rate = 5;                // updates per second per bot, at most
+    int sessions = 1;
+    int threads = 4;
+    int spread = 60;                // bots start within this many hexes of the origin
+    bool fullState = false;         // upload the whole ship every move instead of 'I' inputs
+};
+
+// One simulated player. Only its own ship is tracked out of the snapshots:
+// enough to see when an update has made it through the server and back
+struct Bot
+{
+    int sd;
+    int cid;
+    int session;
+    RingBuffer in;
+    Ship ship;
+    string out;
+    int inputSequence;
+
+    bool waiting;                   // an update is on its way
+    Clock::time_point sentAt;
+    Clock::time_point nextMove;
+    int expect[3];                  // x, y, orientation the update should come back with
+
+    // Own ship record per snapshot sequence, for deltas against older baselines
+    int ownSeq[SNAPSHOT_HISTORY];
+    int own[SNAPSHOT_HISTORY][SHIP_INTS];
+    bool ownSeen[SNAPSHOT_HISTORY];
+};
+
+// What a thread has seen since the last report
+struct Stats
+{
+    mutex lock;
+    long updates = 0;
+    long snapshots = 0;
+    long bytesIn = 0;
+    long bytesOut = 0;
+    long timeouts = 0;
+    long dropped = 0;
+    vector<double> rtts;
+};
+
+Options opts;
+atomic<bool> running(true);
+
+int Connect(const char* host, int port)
+{
+    struct hostent* he = gethostbyname(host);
+    if(he == NULL)
+        return -1;
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
+    addr.sin_port = htons(port);
+
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if(sd < 0)
+        return -1;
+    if(connect(sd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(sd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sd;
+}
+
+// Small enough that a blocking send would only ever stall on a dead server
+void SendAll(int sd, const char* data, int length)
+{
+    while(length > 0)
+    {
+        ssize_t sent = send(sd, data, length, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR)
+            continue;
+        if(sent <= 0)
+            return;
+        data += sent;
+        length -= sent;
+    }
+}
+
+// One step of scripted flying: mostly forward, sometimes a turn, and always a
+// turn at the edge of the board so every update changes something. Applied to
+// our own copy with the server's rules, so we know what should come back.
+// Returns the buttons pressed
+int Move(Bot& bot, mt19937& rng)
+{
+    if(rng() % 4 != 0 && Movement::Forward(&bot.ship, BOARD_COLS, BOARD_ROWS))
+        return INPUT_FORWARD;
+    int buttons = rng() % 2 ? INPUT_RIGHT : INPUT_LEFT;
+    Movement::Apply(&bot.ship, buttons, BOARD_COLS, BOARD_ROWS);
+    return buttons;
+}
+
+// The first update spawns the ship with a whole 'S'; after that only the
+// buttons go up, unless --full-state asks for the old way
+void SendUpdate(Bot& bot, int buttons, Stats& stats)
+{
+    if(buttons == 0 || opts.fullState)
+    {
+        vector<Ship*> list(1, &bot.ship);
+        Protocol::CrunchetizeMeCapn(bot.cid, list, bot.out);
+    }
+    else
+    {
+        bot.out.resize(INPUT_MESSAGE_SIZE);
+        Protocol::PackInputMessage(++bot.inputSequence, buttons, &bot.out[0]);
+    }
+    SendAll(bot.sd, bot.out.data(), bot.out.size());
+
+    bot.waiting = true;
+    bot.sentAt = Clock::now();
+    bot.expect[0] = bot.ship.getXpos();
+    bot.expect[1] = bot.ship.getYpos();
+    bot.expect[2] = bot.ship.getOrientation();
+    stats.updates++;
+    stats.bytesOut += bot.out.size();
+}
+
+// Follows the bot's own ship through a 'D' message without decoding the rest.
+// Returns false if the message is malformed
+bool TrackOwnShip(Bot& bot, const char* msg, int length, Stats& stats)
+{
+    int index = sizeof(char) + sizeof(int);
+    int header[5];  // sequence, base, ship count, removed count, changed count
+    if(length < index + (int)sizeof(header))
+        return false;
+    memcpy(header, &msg[index], sizeof(header));
+    index += sizeof(header);
+    int seq = header[0], base = header[1], removed = header[3], changed = header[4];
+
+    // Start from the baseline's copy of our ship, if it had one
+    int slot = seq % SNAPSHOT_HISTORY;
+    int baseSlot = base < 0 ? -1 : base % SNAPSHOT_HISTORY;
+    bool seen = baseSlot >= 0 && bot.ownSeq[baseSlot] == base && bot.ownSeen[baseSlot];
+    int record[SHIP_INTS];
+    if(seen)
+        memcpy(record, bot.own[baseSlot], sizeof(record));
+
+    if(removed < 0 || changed < 0 || index + removed * (int)sizeof(int) > length)
+        return false;
+    for(int r = 0; r < removed; r++)
+    {
+        int id;
+        memcpy(&id, &msg[index], sizeof(int));
+        index += sizeof(int);
+        if(id == bot.cid)
+            seen = false;
+    }
+    for(int c = 0; c < changed; c++)
+    {
+        int entry[2];   // id, mask
+        if(index + (int)sizeof(entry) > length)
+            return false;
+        memcpy(entry, &msg[index], sizeof(entry));
+        index += sizeof(entry);
+        int fields = __builtin_popcount(entry[1] & ((1 << SHIP_INTS) - 1));
+        if(index + fields * (int)sizeof(int) > length)
+            return false;
+        if(entry[0] != bot.cid)
+        {
+            index += fields * sizeof(int);
+            continue;
+        }
+        if(!seen)
+            memset(record, 0, sizeof(record));
+        seen = true;
+        for(int f = 0; f < SHIP_INTS; f++)
+        {
+            if(entry[1] & (1 << f))
+            {
+                memcpy(&record[f], &msg[index], sizeof(int));
+                index += sizeof(int);
+            }
+        }
+    }
+
+    bot.ownSeq[slot] = seq;
+    bot.ownSeen[slot] = seen;
+    if(seen)
+        memcpy(bot.own[slot], record, sizeof(record));
+
+    char ack[sizeof(char) + sizeof(int)];
+    ack[0] = 'A';
+    memcpy(&ack[sizeof(char)], &seq, sizeof(int));
+    SendAll(bot.sd, ack, sizeof(ack));
+
+    if(bot.waiting && seen && record[1] == bot.expect[0] && record[2] == bot.expect[1] && record[3] == bot.expect[2])
+    {
+        bot.waiting = false;
+        stats.rtts.push_back(chrono::duration<double, micro>(Clock::now() - bot.sentAt).count());
+    }
+    return true;
+}
+
+// Returns false once the server has hung up on this bot
+bool ReadBot(Bot& bot, Stats& stats, mt19937& rng)
+{
+    while(true)
+    {
+        int got = bot.in.ReadFrom(bot.sd);
+        if(got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+            return false;
+        if(got < 0)
+            return true;
+        stats.bytesIn += got;
+
+        int length;
+        const char* msg;
+        while((msg = Protocol::NextMessage(bot.in, length)) != NULL)
+        {
+            if(msg[0] == 'C' && bot.cid < 0)
+            {
+                // Joined: put our ship somewhere on the board and start flying
+                bot.cid = Protocol::ParseClientIDMessage(msg, length);
+                bot.ship.setID(bot.cid);
+                bot.ship.setOwner(bot.cid);
+                bot.ship.setXpos(max(0, min(BOARD_COLS - 1, BOARD_COLS / 2 - opts.spread / 2 + (int)(rng() % (opts.spread + 1)))));
+                bot.ship.setYpos(max(0, min(BOARD_ROWS - 1, BOARD_ROWS / 2 - opts.spread / 2 + (int)(rng() % (opts.spread + 1)))));
+                bot.ship.setOrientation((Orientation)(rng() % 6));
+                bot.ship.setHullPointsMax(100);
+                bot.ship.setHullPointsCur(100);
+                bot.ship.setArmourClass(20);
+                bot.ship.setTargetLock(10);
+                for(int j = 0; j < 4; j++)
+                {
+                    bot.ship.setShieldMax((Shield)j, 50);
+                    bot.ship.setShieldCur((Shield)j, 50);
+                }
+                SendUpdate(bot, 0, stats);
+            }
+            else if(msg[0] == 'D')
+            {
+                stats.snapshots++;
+                if(bot.cid >= 0 && !TrackOwnShip(bot, msg, length, stats))
+                    return false;
+            }
+            bot.in.Consume(length);
+        }
+        if(length < 0)
+            return false;
+    }
+}
+
+void RunBots(vector<Bot*> bots, Stats* stats, int seed)
+{
+    mt19937 rng(seed);
+    EventLoop loop(1024);
+    for(int i = 0; i < bots.size(); i++)
+        loop.Add(bots[i]->sd, EPOLLIN | EPOLLRDHUP | EPOLLET, bots[i]);
+
+    auto interval = chrono::microseconds((long)(1000000 / opts.rate));
+    int alive = bots.size();
+    while(running && alive > 0)
+    {
+        int ready = loop.Wait(1);
+        lock_guard<mutex> guard(stats->lock);
+        for(int e = 0; e < ready; e++)
+        {
+            Bot* bot = (Bot*)loop.getData(e);
+            if(bot->sd >= 0 && !ReadBot(*bot, *stats, rng))
+            {
+                loop.Remove(bot->sd);
+                close(bot->sd);
+                bot->sd = -1;
+                stats->dropped++;
+                alive--;
+            }
+        }
+
+        // Each bot moves again once its last update came back (or never will)
+        // and its think time is up
+        Clock::time_point now = Clock::now();
+        for(int i = 0; i < bots.size(); i++)
+        {
+            Bot* bot = bots[i];
+            if(bot->sd < 0 || bot->cid < 0)
+                continue;
+            if(bot->waiting && now - bot->sentAt > chrono::milliseconds(UPDATE_TIMEOUT_MS))
+            {
+                bot->waiting = false;
+                stats->timeouts++;
+            }
+            if(bot->waiting || now < bot->nextMove)
+                continue;
+            bot->nextMove = now + interval;
+            SendUpdate(*bot, Move(*bot, rng), *stats);
+        }
+    }
+
+    // Say goodbye properly so the server frees our ships
+    for(int i = 0; i < bots.size(); i++)
+    {
+        if(bots[i]->sd < 0)
+            continue;
+        char bye[sizeof(char) + sizeof(int)];
+        bye[0] = '0';
+        memcpy(&bye[sizeof(char)], &bots[i]->cid, sizeof(int));
+        SendAll(bots[i]->sd, bye, sizeof(bye));
+        close(bots[i]->sd);
+    }
+}
+
+double Percentile(vector<double>& sorted, int p)
+{
+    if(sorted.empty())
+        return 0;
+    return sorted[min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--host") == 0 && i + 1 < argc)
+            opts.host = argv[++i];
+        else if(strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            opts.port = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--bots") == 0 && i + 1 < argc)
+            opts.bots = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            opts.seconds = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            opts.rate = atof(argv[++i]);
+        else if(strcmp(argv[i], "--sessions") == 0 && i + 1 < argc)
+            opts.sessions = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            opts.threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--spread") == 0 && i + 1 < argc)
+            opts.spread = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--full-state") == 0)
+            opts.fullState = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--host H] [--port P] [--bots N] [--seconds S] [--rate HZ] [--sessions K] [--threads T] [--spread HEXES] [--full-state]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(opts.rate <= 0 || opts.threads < 1 || opts.sessions < 1 || opts.spread < 0)
+    {
+        fprintf(stderr, "rate, threads and sessions must be positive\n");
+        return 1;
+    }
+
+    struct rlimit lim;
+    if(getrlimit(RLIMIT_NOFILE, &lim) == 0)
+    {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // Connect everyone up front, so the numbers below are steady state
+    vector<Bot*> bots;
+    auto connectStart = Clock::now();
+    for(int i = 0; i < opts.bots; i++)
+    {
+        int sd = Connect(opts.host, opts.port);
+        if(sd < 0)
+        {
+            perror("connect");
+            break;
+        }
+        Bot* bot = new Bot();
+        bot->sd = sd;
+        bot->cid = -1;
+        bot->session = i % opts.sessions;
+        bot->waiting = false;
+        bot->inputSequence = 0;
+        bot->nextMove = Clock::now();
+        for(int h = 0; h < SNAPSHOT_HISTORY; h++)
+            bot->ownSeq[h] = -1;
+
+        char join[sizeof(char) + sizeof(int)];
+        join[0] = 'C';
+        memcpy(&join[sizeof(char)], &bot->session, sizeof(int));
+        SendAll(sd, join, sizeof(join));
+        fcntl(sd, F_SETFL, fcntl(sd, F_GETFL, 0) | O_NONBLOCK);
+        bots.push_back(bot);
+    }
+    double connectMs = chrono::duration<double, milli>(Clock::now() - connectStart).count();
+    fprintf(stderr, "%d bots connected in %.1f ms, %d sessions, %d threads\n", (int)bots.size(), connectMs, opts.sessions, opts.threads);
+    if(bots.empty())
+        return 1;
+
+    int numThreads = min(opts.threads, (int)bots.size());
+    vector<Stats*> stats;
+    vector<thread> threads;
+    for(int t = 0; t < numThreads; t++)
+    {
+        vector<Bot*> mine;
+        for(int i = t; i < bots.size(); i += numThreads)
+            mine.push_back(bots[i]);
+        stats.push_back(new Stats());
+        threads.push_back(thread(RunBots, mine, stats[t], 1234 + t));
+    }
+
+    printf("%8s %8s %12s %12s %12s %12s %12s %12s %12s %8s\n", "second", "bots", "updates/s", "snapshots/s", "kbytes_in/s", "kbytes_out/s", "rtt_p50_us", "rtt_p99_us", "rtt_max_us", "timeouts");
+    long totalUpdates = 0;
+    long totalSnapshots = 0;
+    long totalTimeouts = 0;
+    long dropped = 0;
+    vector<double> allRtts;
+    for(int second = 1; second <= opts.seconds; second++)
+    {
+        this_thread::sleep_for(chrono::seconds(1));
+
+        long updates = 0, snapshots = 0, bytesIn = 0, bytesOut = 0, timeouts = 0;
+        vector<double> rtts;
+        for(int t = 0; t < stats.size(); t++)
+        {
+            lock_guard<mutex> guard(stats[t]->lock);
+            updates += stats[t]->updates;
+            snapshots += stats[t]->snapshots;
+            bytesIn += stats[t]->bytesIn;
+            bytesOut += stats[t]->bytesOut;
+            timeouts += stats[t]->timeouts;
+            dropped += stats[t]->dropped;
+            rtts.insert(rtts.end(), stats[t]->rtts.begin(), stats[t]->rtts.end());
+            stats[t]->updates = stats[t]->snapshots = stats[t]->bytesIn = stats[t]->bytesOut = stats[t]->timeouts = stats[t]->dropped = 0;
+            stats[t]->rtts.clear();
+        }
+        sort(rtts.begin(), rtts.end());
+        printf("%8d %8d %12ld %12ld %12.1f %12.1f %12.1f %12.1f %12.1f %8ld\n", second, (int)(bots.size() - dropped),
+            updates, snapshots, bytesIn / 1024.0, bytesOut / 1024.0, Percentile(rtts, 50), Percentile(rtts, 99),
+            rtts.empty() ? 0 : rtts.back(), timeouts);
+        fflush(stdout);
+
+        totalUpdates += updates;
+        totalSnapshots += snapshots;
+        totalTimeouts += timeouts;
+        allRtts.insert(allRtts.end(), rtts.begin(), rtts.end());
+    }
+
+    running = false;
+    for(int t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    sort(allRtts.begin(), allRtts.end());
+    printf("summary: %d bots, %.1f updates/s, %.1f snapshots/s, rtt p50 %.1f us, p99 %.1f us, %ld timeouts, %ld dropped\n",
+        (int)bots.size(), (double)totalUpdates / opts.seconds, (double)totalSnapshots / opts.seconds,
+        Percentile(allRtts, 50), Percentile(allRtts, 99), totalTimeouts, dropped);
+
+    for(int i = 0; i < bots.size(); i++)
+        delete bots[i];
+    for(int t = 0; t < stats.size(); t++)
+        delete stats[t];
+    return 0;
+}
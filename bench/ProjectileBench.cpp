@@ -0,0 +1,160 @@
+//Projectile ('P') serialization benchmark, no server needed.
+//Fills a pool with a burst of projectiles, then serializes and parses it
+//over and over, checking that what comes out is what went in. For
+//comparison it does the same the way ships went before ShipRecord: one
+//object and one memcpy per field for every projectile.
+//
+//usage: projectileBench [projectiles per message] [rounds]
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include "../src/Projectile.h"
+#include "../src/ProjectilePool.h"
+#include "../src/Protocol.h"
+
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+// The per-object layout: each projectile's fields one after the other
+void SerializeObjects(const vector<Projectile*>& projectiles, string& out)
+{
+    int count = projectiles.size();
+    int message_size = PROJECTILE_HEADER_SIZE + count * PROJECTILE_BYTES;
+    out.resize(message_size);
+    char* message = &out[0];
+    message[0] = 'P';
+    memcpy(&message[sizeof(char)], &message_size, sizeof(int));
+    memcpy(&message[sizeof(char) + sizeof(int)], &count, sizeof(int));
+    int index = PROJECTILE_HEADER_SIZE;
+    for(int i = 0; i < count; i++)
+    {
+        int val = projectiles[i]->getX_pos();
+        memcpy(&message[index], &val, sizeof(int));
+        index += sizeof(int);
+        val = projectiles[i]->getY_pos();
+        memcpy(&message[index], &val, sizeof(int));
+        index += sizeof(int);
+        val = projectiles[i]->getRoll();
+        memcpy(&message[index], &val, sizeof(int));
+        index += sizeof(int);
+        val = projectiles[i]->getDamage();
+        memcpy(&message[index], &val, sizeof(int));
+        index += sizeof(int);
+        message[index++] = (char)projectiles[i]->getOrientation();
+    }
+}
+
+void ParseObjects(const string& message, vector<Projectile*>& projectiles)
+{
+    for(int i = 0; i < projectiles.size(); i++)
+        delete projectiles[i];
+    projectiles.clear();
+    int count;
+    memcpy(&count, &message[sizeof(char) + sizeof(int)], sizeof(int));
+    int index = PROJECTILE_HEADER_SIZE;
+    for(int i = 0; i < count; i++)
+    {
+        Projectile* p = new Projectile();
+        int val;
+        memcpy(&val, &message[index], sizeof(int));
+        index += sizeof(int);
+        p->setX_pos(val);
+        memcpy(&val, &message[index], sizeof(int));
+        index += sizeof(int);
+        p->setY_pos(val);
+        memcpy(&val, &message[index], sizeof(int));
+        index += sizeof(int);
+        p->setRoll(val);
+        memcpy(&val, &message[index], sizeof(int));
+        index += sizeof(int);
+        p->setDamage(val);
+        p->setOrientation((POrientation)message[index++]);
+        projectiles.push_back(p);
+    }
+}
+
+double Us(Clock::time_point from, Clock::time_point to)
+{
+    return chrono::duration<double, micro>(to - from).count();
+}
+
+int main(int argc, char* argv[])
+{
+    int count = argc >= 2 ? atoi(argv[1]) : 10000;
+    int rounds = argc >= 3 ? atoi(argv[2]) : 500;
+    if(count < 0 || rounds <= 0)
+    {
+        cerr << "usage: projectileBench [projectiles per message] [rounds]\n";
+        return 1;
+    }
+
+    mt19937 rng(1);
+    ProjectilePool sent(count);
+    vector<Projectile*> objects;
+    for(int i = 0; i < count; i++)
+    {
+        Projectile p(rng() % 20 + 1, rng() % 100, rng() % 100, (POrientation)(rng() % 6));
+        p.setDamage(rng() % 12);
+        sent.Add(p);
+        objects.push_back(new Projectile(p));
+    }
+
+    string message;
+    ProjectilePool received;
+    Clock::time_point start = Clock::now();
+    for(int r = 0; r < rounds; r++)
+        Protocol::SerializeProjectiles(sent, message);
+    Clock::time_point serialized = Clock::now();
+    for(int r = 0; r < rounds; r++)
+    {
+        if(!Protocol::ParseProjectileMessage(message.data(), message.size(), received))
+        {
+            cerr << "'P' did not parse\n";
+            return 1;
+        }
+    }
+    Clock::time_point parsed = Clock::now();
+
+    for(int i = 0; i < count; i++)
+    {
+        if(received.getX(i) != sent.getX(i) || received.getY(i) != sent.getY(i) || received.getRoll(i) != sent.getRoll(i)
+            || received.getDamage(i) != sent.getDamage(i) || received.getOrientation(i) != sent.getOrientation(i))
+        {
+            cerr << "projectile " << i << " parsed wrong\n";
+            return 1;
+        }
+    }
+
+    string objectMessage;
+    vector<Projectile*> parsedObjects;
+    Clock::time_point objectStart = Clock::now();
+    for(int r = 0; r < rounds; r++)
+        SerializeObjects(objects, objectMessage);
+    Clock::time_point objectSerialized = Clock::now();
+    for(int r = 0; r < rounds; r++)
+        ParseObjects(objectMessage, parsedObjects);
+    Clock::time_point objectParsed = Clock::now();
+
+    double mb = (double)message.size() * rounds / (1024 * 1024);
+    printf("%d projectiles per message, %zu bytes, %d rounds\n", count, message.size(), rounds);
+    printf("layout   serialize_us  parse_us  serialize_MB/s  parse_MB/s  parse_Mprojectiles/s\n");
+    printf("columns  %12.1f  %8.1f  %14.0f  %10.0f  %20.1f\n",
+        Us(start, serialized) / rounds, Us(serialized, parsed) / rounds,
+        mb / Us(start, serialized) * 1e6, mb / Us(serialized, parsed) * 1e6,
+        (double)count * rounds / Us(serialized, parsed));
+    printf("objects  %12.1f  %8.1f  %14.0f  %10.0f  %20.1f\n",
+        Us(objectStart, objectSerialized) / rounds, Us(objectSerialized, objectParsed) / rounds,
+        mb / Us(objectStart, objectSerialized) * 1e6, mb / Us(objectSerialized, objectParsed) * 1e6,
+        (double)count * rounds / Us(objectSerialized, objectParsed));
+
+    for(int i = 0; i < objects.size(); i++)
+        delete objects[i];
+    for(int i = 0; i < parsedObjects.size(); i++)
+        delete parsedObjects[i];
+    return 0;
+}
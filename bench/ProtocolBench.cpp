@@ -0,0 +1,219 @@
+//Protocol microbenchmarks for `make bench`, no server or SFML needed.
+//  protocol:    'S' messages (CrunchetizeMeCapn, ParseShipMessage, the
+//               SnapshotView/ShipUpdater path), snapshot packing, and 'D'/'Q'
+//               keyframes and deltas, at 1 to 10000 ships
+//  projectiles: 'P' bursts of 10000
+//  fanout:      one snapshot broadcast the way Session does it, minus the
+//               sockets: interest queries, one snapshot per distinct view and
+//               one encode per distinct baseline, for 10 to 1000 clients
+//Results are JSON lines, see Bench.h.
+#include <vector>
+#include <string>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <random>
+#include "Bench.h"
+#include "../src/Ship.h"
+#include "../src/Protocol.h"
+#include "../src/Snapshot.h"
+#include "../src/ShipView.h"
+#include "../src/ProjectilePool.h"
+#include "../src/InterestGrid.h"
+#include "../src/Movement.h"
+
+using namespace std;
+
+vector<Ship*> MakeFleet(int n, mt19937& rng)
+{
+    vector<Ship*> ships;
+    for(int i = 0; i < n; i++)
+    {
+        int shields[4] = {20, 15, 15, 10};
+        Ship* ship = new Ship(i, 6, AVERAGE, 14, 5, 10, 5, 100, 40, shields);
+        ship->setXpos(rng() % BOARD_COLS);
+        ship->setYpos(rng() % BOARD_ROWS);
+        ship->setOrientation((Orientation)(rng() % 6));
+        ship->setOwner(i);
+        ships.push_back(ship);
+    }
+    return ships;
+}
+
+// A quarter of the ships take a step, like the load bots between snapshots
+void MoveSome(vector<Ship*>& ships, mt19937& rng)
+{
+    for(int i = 0; i < ships.size(); i++)
+    {
+        if(rng() % 4 == 0)
+            Movement::Apply(ships[i], 1 << (rng() % 3), BOARD_COLS, BOARD_ROWS);
+    }
+}
+
+void FreeFleet(vector<Ship*>& ships)
+{
+    for(int i = 0; i < ships.size(); i++)
+        delete ships[i];
+    ships.clear();
+}
+
+void ProtocolSuite()
+{
+    int sizes[] = {1, 10, 100, 1000, 10000};
+    for(int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        int n = sizes[s];
+        mt19937 rng(n);
+        vector<Ship*> ships = MakeFleet(n, rng);
+
+        string message;
+        Protocol::CrunchetizeMeCapn(0, ships, message);
+        Bench::Run("protocol", "crunch", n, message.size(), [&]()
+        {
+            Protocol::CrunchetizeMeCapn(0, ships, message);
+            Bench::KeepAlive(message);
+        });
+
+        Bench::Run("protocol", "parse", n, message.size(), [&]()
+        {
+            int cid;
+            vector<Ship*> parsed = Protocol::ParseShipMessage(-1, message.data(), message.size(), cid);
+            FreeFleet(parsed);
+        });
+
+        vector<Ship*> patched;
+        ShipUpdater updater;
+        Bench::Run("protocol", "view_apply", n, message.size(), [&]()
+        {
+            SnapshotView view;
+            view.Parse(message.data(), message.size());
+            updater.Apply(view, patched);
+        });
+        FreeFleet(patched);
+
+        Bench::Run("protocol", "snapshot_pack", n, -1, [&]()
+        {
+            Snapshot snapshot(1, ships);
+            Bench::KeepAlive(snapshot);
+        });
+
+        Snapshot before(1, ships);
+        MoveSome(ships, rng);
+        Snapshot after(2, ships);
+        Snapshot decoded;
+
+        const char* formats[2] = {"D", "Q"};
+        for(int f = 0; f < 2; f++)
+        {
+            bool packed = f == 1;
+            for(int delta = 0; delta < 2; delta++)
+            {
+                const Snapshot* base = delta ? &before : NULL;
+                string encoded;
+                if(packed)
+                    after.EncodePacked(base, encoded);
+                else
+                    after.EncodeDelta(base, encoded);
+
+                string name = string(delta ? "delta_" : "keyframe_") + formats[f];
+                Bench::Run("protocol", ("encode_" + name).c_str(), n, encoded.size(), [&]()
+                {
+                    encoded.clear();
+                    if(packed)
+                        after.EncodePacked(base, encoded);
+                    else
+                        after.EncodeDelta(base, encoded);
+                });
+                Bench::Run("protocol", ("decode_" + name).c_str(), n, encoded.size(), [&]()
+                {
+                    decoded.DecodeDelta(encoded.data(), encoded.size(), base);
+                });
+            }
+        }
+        FreeFleet(ships);
+    }
+}
+
+void ProjectileSuite()
+{
+    int n = 10000;
+    mt19937 rng(n);
+    ProjectilePool pool(n);
+    for(int i = 0; i < n; i++)
+        pool.Add(rng() % 100, rng() % 100, rng() % 20 + 1, rng() % 12, (POrientation)(rng() % 6));
+
+    string message;
+    Protocol::SerializeProjectiles(pool, message);
+    Bench::Run("projectiles", "serialize", n, message.size(), [&]()
+    {
+        Protocol::SerializeProjectiles(pool, message);
+        Bench::KeepAlive(message);
+    });
+
+    ProjectilePool received(n);
+    Bench::Run("projectiles", "parse", n, message.size(), [&]()
+    {
+        Protocol::ParseProjectileMessage(message.data(), message.size(), received);
+    });
+}
+
+// What Session::BroadcastSnapshot does per tick, for clients spread over
+// the board with every client acknowledging its previous snapshot
+void FanoutSuite()
+{
+    int numShips = 1000;
+    int clients[] = {10, 100, 1000};
+    for(int c = 0; c < sizeof(clients) / sizeof(clients[0]); c++)
+    {
+        int numClients = clients[c];
+        mt19937 rng(numClients);
+        vector<Ship*> ships = MakeFleet(numShips, rng);
+        vector< shared_ptr<const Snapshot> > baselines(numClients);
+        InterestGrid interest;
+        vector<int> visible;
+        int seq = 0;
+        long bytes = 0;
+
+        auto broadcast = [&]()
+        {
+            MoveSome(ships, rng);
+            seq++;
+            map<vector<int>, shared_ptr<const Snapshot> > views;
+            map<tuple<const Snapshot*, const Snapshot*>, string> encoded;
+            interest.Rebuild(ships);
+            bytes = 0;
+            for(int i = 0; i < numClients; i++)
+            {
+                // Client i flies ship i (clients past the fleet share ships)
+                Ship* own = ships[i % numShips];
+                interest.Query(own->getXpos(), own->getYpos(), own->getSensorRange(), visible);
+                shared_ptr<const Snapshot>& view = views[visible];
+                if(!view)
+                    view = make_shared<Snapshot>(seq, ships, visible);
+
+                auto key = make_tuple(baselines[i].get(), view.get());
+                auto enc = encoded.find(key);
+                if(enc == encoded.end())
+                {
+                    enc = encoded.insert(make_pair(key, string())).first;
+                    view->EncodePacked(baselines[i].get(), enc->second);
+                }
+                bytes += enc->second.size();
+                baselines[i] = view;
+            }
+        };
+
+        broadcast();
+        Bench::Run("fanout", "broadcast_1000_ships", numClients, bytes, broadcast);
+        FreeFleet(ships);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Bench::Init(argc, argv);
+    ProtocolSuite();
+    ProjectileSuite();
+    FanoutSuite();
+    return 0;
+}
@@ -0,0 +1,159 @@
+//Snapshot wire format benchmark, no server needed.
+//Flies a fleet around the board the way the load bots do (a quarter of the
+//ships move each snapshot, now and then one takes a hit) and encodes every
+//snapshot as a delta against the one before it, in both formats: 'D' (whole
+//ints) and 'Q' (bit packed, WIRE_VERSION_PACKED). Every message is decoded
+//again and checked against the original, so a broken codec fails loudly
+//rather than benchmarking well.
+//
+//usage: wireBench [ships] [snapshots]
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include "../src/Ship.h"
+#include "../src/Protocol.h"
+#include "../src/Snapshot.h"
+#include "../src/Movement.h"
+
+using namespace std;
+typedef chrono::steady_clock Clock;
+
+struct Result
+{
+    long keyframeBytes = 0;
+    long deltaBytes = 0;
+    double encodeNs = 0;
+    double decodeNs = 0;
+};
+
+bool Same(const Snapshot& a, const Snapshot& b)
+{
+    if(a.getShipCount() != b.getShipCount() || a.getSequence() != b.getSequence())
+        return false;
+    for(int i = 0; i < a.getShipCount(); i++)
+    {
+        if(memcmp(a.getRecord(i), b.getRecord(i), SHIP_INTS * sizeof(int)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// Encodes snapshots[i] against snapshots[i - 1] (the first as a keyframe),
+// decodes it on top of the previous decode, and times both halves
+bool Run(const vector<Snapshot>& snapshots, bool packed, Result& result)
+{
+    string message;
+    Snapshot decoded[2];
+    double encodeNs = 0;
+    double decodeNs = 0;
+
+    for(int i = 0; i < snapshots.size(); i++)
+    {
+        const Snapshot* base = i == 0 ? NULL : &snapshots[i - 1];
+        message.clear();
+        Clock::time_point start = Clock::now();
+        if(packed)
+            snapshots[i].EncodePacked(base, message);
+        else
+            snapshots[i].EncodeDelta(base, message);
+        Clock::time_point encoded = Clock::now();
+
+        Snapshot& into = decoded[i % 2];
+        const Snapshot* decodedBase = i == 0 ? NULL : &decoded[(i + 1) % 2];
+        if(Protocol::FrameLength(message.data(), message.size()) != (int)message.size()
+            || !into.DecodeDelta(message.data(), message.size(), decodedBase))
+        {
+            cerr << (packed ? "'Q'" : "'D'") << " snapshot " << i << " did not decode\n";
+            return false;
+        }
+        Clock::time_point done = Clock::now();
+        if(!Same(into, snapshots[i]))
+        {
+            cerr << (packed ? "'Q'" : "'D'") << " snapshot " << i << " decoded wrong\n";
+            return false;
+        }
+
+        if(i == 0)
+            result.keyframeBytes = message.size();
+        else
+        {
+            result.deltaBytes += message.size();
+            encodeNs += chrono::duration<double, nano>(encoded - start).count();
+            decodeNs += chrono::duration<double, nano>(done - encoded).count();
+        }
+    }
+    int deltas = snapshots.size() - 1;
+    result.encodeNs = encodeNs / deltas;
+    result.decodeNs = decodeNs / deltas;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int numShips = argc >= 2 ? atoi(argv[1]) : 100;
+    int numSnapshots = argc >= 3 ? atoi(argv[2]) : 2000;
+    if(numShips <= 0 || numSnapshots < 2)
+    {
+        cerr << "usage: wireBench [ships] [snapshots >= 2]\n";
+        return 1;
+    }
+
+    mt19937 rng(1);
+    vector<Ship*> ships;
+    for(int i = 0; i < numShips; i++)
+    {
+        int shields[4] = {20, 15, 15, 10};
+        Ship* ship = new Ship(i, 6, AVERAGE, 14, 5, 10, 5, 100, 40, shields);
+        ship->setXpos(rng() % BOARD_COLS);
+        ship->setYpos(rng() % BOARD_ROWS);
+        ship->setOrientation((Orientation)(rng() % 6));
+        ship->setOwner(i);
+        ships.push_back(ship);
+    }
+
+    vector<Snapshot> snapshots;
+    snapshots.reserve(numSnapshots);
+    for(int s = 0; s < numSnapshots; s++)
+    {
+        for(int i = 0; i < numShips; i++)
+        {
+            if(rng() % 4 == 0)
+                Movement::Apply(ships[i], 1 << (rng() % 3), BOARD_COLS, BOARD_ROWS);
+            if(rng() % 50 == 0)
+                ships[i]->setShieldCur((Shield)(rng() % 4), rng() % 21);
+        }
+        snapshots.push_back(Snapshot(s + 1, ships));
+    }
+
+    Result ints;
+    Result packed;
+    if(!Run(snapshots, false, ints) || !Run(snapshots, true, packed))
+        return 1;
+
+    int deltas = numSnapshots - 1;
+    printf("%d ships, %d snapshots\n", numShips, numSnapshots);
+    printf("format  keyframe_bytes  delta_bytes  encode_us  decode_us  encode_MB/s  decode_MB/s\n");
+    const Result* results[2] = {&ints, &packed};
+    const char* names[2] = {"D", "Q"};
+    for(int r = 0; r < 2; r++)
+    {
+        // Throughput in terms of the ship records carried, so both formats are
+        // measured against the same amount of game state
+        double recordBytes = (double)numShips * SHIP_INTS * sizeof(int);
+        printf("%-6s  %14ld  %11.1f  %9.2f  %9.2f  %11.1f  %11.1f\n", names[r],
+            results[r]->keyframeBytes, (double)results[r]->deltaBytes / deltas,
+            results[r]->encodeNs / 1000, results[r]->decodeNs / 1000,
+            recordBytes / results[r]->encodeNs * 1000, recordBytes / results[r]->decodeNs * 1000);
+    }
+    printf("keyframes %.2fx smaller, deltas %.2fx smaller\n",
+        (double)ints.keyframeBytes / packed.keyframeBytes, (double)ints.deltaBytes / packed.deltaBytes);
+
+    for(int i = 0; i < numShips; i++)
+        delete ships[i];
+    return 0;
+}
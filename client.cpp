@@ -19,11 +19,20 @@ int main(int argc, char *argv[])
 
     char *serverIp;
     int port;
-    // Gets the IP and Port
+    int session = 0;
+    // Gets the IP and Port, and optionally which battle on that server to join
     if(argc >= 3){
         serverIp = argv[1]; 
         port = atoi(argv[2]);
     }
+    if(argc >= 4)
+        session = atoi(argv[3]);
+    // "udp" takes ship snapshots by datagram, everything else stays on TCP
+    bool udp = argc >= 5 && strcmp(argv[4], "udp") == 0;
+    // Round trip milliseconds to add on top of the real one, to try prediction
+    int lag = argc >= 6 ? atoi(argv[5]) : 0;
+    // How far in the past remote ships are drawn, smoothing out bursty snapshots
+    int interpolation = argc >= 7 ? atoi(argv[6]) : DEFAULT_INTERPOLATION_DELAY;
     // window logic
     sf::RenderWindow window(sf::VideoMode(1270, 720), "Starfinder Commander");
     window.setFramerateLimit(60);
@@ -35,6 +44,10 @@ int main(int argc, char *argv[])
     GameScreen gameScreen;
     PauseMenu pauseMenu;
     ServerPicker serverPicker;
+    gameScreen.setSession(session);
+    gameScreen.setUdp(udp);
+    gameScreen.setLag(lag);
+    gameScreen.setInterpolationDelay(interpolation);
 
     Screens.push_back(&mainMenu);   // 0 - Main Menu 
     Screens.push_back(&gameScreen); // 1 - Game Screen
@@ -7,21 +7,35 @@
 #include <stdio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
 #include <netdb.h>
 #include <thread>
+#include <unordered_map>
+#include <poll.h>
+#include <errno.h>
 #include "../src/HexGrid.h"
 #include "../src/Ship.h"
 #include "../src/Crewman.h"
 #include "../src/Projectile.h"
 #include "../src/Protocol.h"
+#include "../src/Snapshot.h"
+#include "../src/ShipView.h"
+#include "../src/Movement.h"
+#include "../src/Prediction.h"
+#include "../src/DelayLine.h"
+#include "../src/Interpolation.h"
+#include "../src/SpriteAtlas.h"
+#include "../src/SpriteBatch.h"
+#include "../src/TripleBuffer.h"
 #include "Screen.hpp"
 
 #define DRAG_TIMEOUT 200			// in milliseconds
 #define DOUBLE_CLICK_TIMEOUT 500	// in milliseconds
 #define INPUT_DELAY 100 // milliseconds
+#define UDP_HELLO_INTERVAL 250 // milliseconds between hellos until the server's first datagram
 
 using namespace std;
 
@@ -36,6 +50,13 @@ public:
         ClientID = 'C',
         Ships = 'S',
         Projectiles = 'P',
+        Delta = 'D',
+        PackedDelta = 'Q',
+        WireVersion = 'V',
+        Ack = 'A',
+        Udp = 'U',
+        Input = 'I',
+        InputAck = 'K',
         CloseSocket = '0',
         Invalid = 'Z'
     };
@@ -44,8 +65,8 @@ public:
     {
     private:
         Ship* ship;
-        sf::Sprite* sprite;
-        sf::Texture* tex;
+        sf::Sprite* sprite;     // our image in the screen's atlas, and where it goes
+        unsigned long lastSeen = 0;     // CheckDrawShips pass that last found this ship
 
         bool myTurn = true;
 
@@ -54,24 +75,16 @@ public:
         DrawShip()
         {
             this->sprite = new sf::Sprite();
-            this->tex = new sf::Texture();
         }
 
         DrawShip(const DrawShip& cpy)
         {
-            delete this->sprite;
-            delete this->tex;
-
             this->ship = new Ship(*cpy.getShip());
             this->sprite = new sf::Sprite(*cpy.getSprite());
-            this->tex = new sf::Texture(*cpy.getTex());
         }
 
             ~DrawShip()
         {
-            delete tex;
-            this->tex = nullptr;
-
             delete sprite;
             this->sprite = nullptr;
         }
@@ -80,23 +93,21 @@ public:
         {
             delete this->ship;
             delete this->sprite;
-            delete this->tex;
 
             this->ship = new Ship(*rhs.getShip());
             this->sprite = new sf::Sprite(*rhs.getSprite());
-            this->tex = new sf::Texture(*rhs.getTex());
 
             return *this;   
         }
 
-        void setTex(sf::Texture* t)
+        void setLastSeen(unsigned long pass)
         {
-            tex = t;
+            lastSeen = pass;
         }
 
-        sf::Texture* getTex() const
+        unsigned long getLastSeen() const
         {
-            return tex;
+            return lastSeen;
         }
 
         void setShip(Ship* sh)
@@ -134,12 +145,27 @@ public:
             return this->sprite;
         }
 
-        void Draw(sf::RenderWindow &window, HexGrid &grid)
+        // Placed and turned where the ship is, then added to batch to be drawn
+        // with all the others if it is in view
+        void Draw(SpriteBatch &batch, HexGrid &grid, const sf::FloatRect &view)
         {
             this->sprite->setPosition(grid.offset_to_pixel(sf::Vector2f((float)this->ship->getXpos(), (float)this->ship->getYpos())  ));
             this->sprite->setRotation(60.0 * this->ship->getOrientation());
             
-            window.draw( *this->sprite );
+            if (this->sprite->getGlobalBounds().intersects(view))
+                batch.Add( *this->sprite );
+        }
+
+        // Somewhere between two hexes, for remote ships drawn from the jitter buffer
+        void Draw(SpriteBatch &batch, HexGrid &grid, const sf::FloatRect &view, const ShipPose &pose)
+        {
+            sf::Vector2f from = grid.offset_to_pixel(sf::Vector2f((float)pose.fromX, (float)pose.fromY));
+            sf::Vector2f to = grid.offset_to_pixel(sf::Vector2f((float)pose.toX, (float)pose.toY));
+            this->sprite->setPosition(from + (to - from) * pose.t);
+            this->sprite->setRotation(60.0 * pose.orientation);
+
+            if (this->sprite->getGlobalBounds().intersects(view))
+                batch.Add( *this->sprite );
         }
 
         void Move(HexGrid grid, int x, int y)
@@ -165,61 +191,12 @@ public:
             return true;
         }
 
+        // Same rules the server applies our 'I' messages with (src/Movement.cpp)
         void Forward(HexGrid grid)
         {
             if(myTurn == false)
                 return;
-            int gridCols = grid.getCols() - 1;
-            int gridRows = grid.getRows() - 1;
-            switch (this->ship->getOrientation())
-            {
-            case EAST:
-                if (this->ship->getXpos() == gridCols)
-                    return;
-                this->ship->setXpos(this->ship->getXpos() + 1);
-                this->ship->setYpos(this->ship->getYpos() + 0);
-                break;
-
-            case NORTHEAST:
-                if ((this->ship->getXpos() == gridCols && this->ship->getYpos() % 2 == 0) || this->ship->getYpos() == 0)
-                    return;
-                if(this->ship->getYpos() % 2 == 0 )
-                    this->ship->setXpos(this->ship->getXpos() + 1);
-                this->ship->setYpos(this->ship->getYpos() - 1);
-                break;
-
-            case NORTHWEST:
-                if ((this->ship->getXpos() == 0 && this->ship->getYpos() % 2 != 0) || this->ship->getYpos() == 0)
-                    return;
-                if (this->ship->getYpos() % 2 != 0)
-                    this->ship->setXpos(this->ship->getXpos() - 1);
-                this->ship->setYpos(this->ship->getYpos() - 1);
-                break;
-
-            case WEST:
-                if (this->ship->getXpos() == 0)
-                    return;
-                this->ship->setXpos(this->ship->getXpos() - 1);
-                this->ship->setYpos(this->ship->getYpos() + 0);
-                break;
-
-            case SOUTHWEST:
-                if ((this->ship->getXpos() == 0 && this->ship->getYpos() % 2 != 0) || this->ship->getYpos() == gridRows)
-                    return;
-                if (this->ship->getYpos() % 2 != 0)
-                    this->ship->setXpos(this->ship->getXpos() - 1);
-                this->ship->setYpos(this->ship->getYpos() + 1);
-                break;
-
-            case SOUTHEAST:
-
-                if ((this->ship->getXpos() == gridCols && this->ship->getYpos() % 2 == 0) || this->ship->getYpos() == gridRows)
-                    return;
-                if (this->ship->getYpos() % 2 == 0)
-                    this->ship->setXpos(this->ship->getXpos() + 1);
-                this->ship->setYpos(this->ship->getYpos() + 1);
-                break;
-            }
+            Movement::Forward(this->ship, grid.getCols(), grid.getRows());
         }
         void Back(HexGrid grid)
         {
@@ -227,79 +204,255 @@ public:
         }
         void Right()
         {
-            if (this->ship->getOrientation() == 5)
-                this->ship->setOrientation((Orientation)0);
-            else
-                this->ship->setOrientation((Orientation) ( (int) this->ship->getOrientation() + 1) );
+            Movement::Right(this->ship);
         }
         void Left()
         {
-            if (this->ship->getOrientation() == 0)
-                this->ship->setOrientation((Orientation)5);
-            else
-                this->ship->setOrientation((Orientation)((int)this->ship->getOrientation() - 1));
+            Movement::Left(this->ship);
         }
     };
 
     // Thread to check for server sending messages
-    static void checkerThread(vector<Ship*>* ships, int* cid, int* clientSd, bool * chkPtr)
+    // received holds everything read and not yet handled; one recv can carry
+    // several messages, or only part of one. Snapshots can also come in by UDP
+    // once the server answers our 'U' request, so both sockets are polled.
+    // With injected lag every message waits in inbound until its time comes
+    // Ship lists go to the render loop through shipStates: each snapshot is
+    // patched into the back list, which is then published whole
+    static void checkerThread(TripleBuffer< vector<Ship*> >* shipStates, int* cid, int* clientSd, bool * chkPtr, RingBuffer* received,
+        Prediction* prediction, DelayLine* inbound, Interpolator* interpolator)
     {
-        // Buffer for the message incoming
-        char receivedMessage[1500];
-        while (*chkPtr)
+        const char* receivedMessage;
+        int size = 0;
+
+        // Recently applied snapshots, the baselines the server deltas against
+        Snapshot history[SNAPSHOT_HISTORY];
+        Snapshot next;
+        int newest = -1;        // snapshots arrive on two channels, older ones are dropped
+        ShipUpdater updater;    // ships are patched in place, not rebuilt every snapshot
+        ProjectilePool projectiles;
+
+        int udpSd = -1;
+        int udpToken = -1;
+        bool udpHeard = false;  // keep saying hello until the first datagram
+
+        // Tell the server it can delta against this one from now on, on the
+        // channel the snapshots come in on
+        auto acknowledge = [&](int sequence)
         {
-            // Clear buffer
-            memset(receivedMessage, 0, sizeof(receivedMessage));
+            char ackType = static_cast<char>(MsgType::Ack);
+            if(udpSd >= 0)
+            {
+                char ack[sizeof(char) + 2 * sizeof(int)];
+                memcpy(&ack[0], &ackType, sizeof(char));
+                memcpy(&ack[sizeof(char)], &udpToken, sizeof(int));
+                memcpy(&ack[sizeof(char) + sizeof(int)], &sequence, sizeof(int));
+                send(udpSd, ack, sizeof(ack), 0);
+                return;
+            }
+            char ack[sizeof(char) + sizeof(int)];
+            memcpy(&ack[0], &ackType, sizeof(char));
+            memcpy(&ack[sizeof(char)], &sequence, sizeof(int));
+            send(*clientSd, ack, sizeof(ack), 0);
+        };
 
-            // Try to receive a message from the server
-            recv(*clientSd, (char*)&receivedMessage, sizeof(receivedMessage), 0);
+        auto applyDelta = [&](const char* message, int message_size)
+        {
+            if(Snapshot::Sequence(message) <= newest)
+                return;
+            int base = Snapshot::BaseSequence(message);
+            Snapshot* baseSnap = base < 0 ? NULL : &history[base % SNAPSHOT_HISTORY];
+            // Baseline already gone, skip it; the server resends from our last ack
+            if(!next.DecodeDelta(message, message_size, baseSnap))
+                return;
+
+            Snapshot& applied = history[next.getSequence() % SNAPSHOT_HISTORY];
+            std::swap(applied, next);
+            newest = applied.getSequence();
+            acknowledge(newest);
+
+            vector<Ship*>& ships = shipStates->Back();
+            updater.Apply(SnapshotView(applied), ships);
+            interpolator->Record(ships);
 
-            if(!strcmp(receivedMessage, "exit"))
+            // Our ship as the server had it, plus whatever we did since
+            for(int i = 0; i < ships.size(); i++)
             {
-                cerr << "Server has quit the session" << endl;
-                exit(0);
+                if(ships[i]->getID() == *cid)
+                    prediction->Reconcile(ships[i], newest);
             }
+            shipStates->Publish();
+        };
 
-            int size = 0;
-            for(int i = 0; receivedMessage[i] != '\0'; i++)
-                size += 1;
-
+        auto sayHello = [&]()
+        {
+            char hello[sizeof(char) + sizeof(int)];
+            char helloType = static_cast<char>(MsgType::Udp);
+            memcpy(&hello[0], &helloType, sizeof(char));
+            memcpy(&hello[sizeof(char)], &udpToken, sizeof(int));
+            send(udpSd, hello, sizeof(hello), 0);
+        };
+
+        auto handleMessage = [&](const char* message, int message_size)
+        {
             MsgType msgType = MsgType::Invalid;
-            memcpy(&msgType, &receivedMessage[0], sizeof(char));
-            std::vector<Ship*> resultShips;
-            int fromServer = -1;
+            memcpy(&msgType, &message[0], sizeof(char));
+            SnapshotView view;
             switch(static_cast<char>(msgType))
             {
                 case static_cast<char>(MsgType::ClientID):
-                    *cid = Protocol::ParseClientIDMessage(receivedMessage, size);
+                    *cid = Protocol::ParseClientIDMessage(message, message_size);
                     cerr << "Client ID received : " << *cid << "\n";
-                    while(ships->size() < *cid)
+                    break;
+
+                case static_cast<char>(MsgType::Ships):
+                    if(view.Parse(message, message_size))
                     {
-                        cerr << "Ship size is " << ships->size() << "Adding entry\n"; 
-                        ships->push_back(new Ship());
+                        updater.Apply(view, shipStates->Back());
+                        shipStates->Publish();
                     }
                     break;
 
-                case static_cast<char>(MsgType::Ships):
+                case static_cast<char>(MsgType::Delta):
+                case static_cast<char>(MsgType::PackedDelta):
+                    applyDelta(message, message_size);
+                    break;
+
+                // Snapshot format the server settled on; both decode the same way
+                case static_cast<char>(MsgType::WireVersion):
+                {
+                    int version;
+                    memcpy(&version, &message[sizeof(char)], sizeof(int));
+                    cerr << "Snapshot wire version " << version << "\n";
+                    break;
+                }
+
+                // Which of our inputs the next snapshot already includes
+                case static_cast<char>(MsgType::InputAck):
+                {
+                    int snapshotSequence, inputSequence;
+                    Protocol::ParseInputAck(message, snapshotSequence, inputSequence);
+                    prediction->Acknowledge(snapshotSequence, inputSequence);
+                    break;
+                }
 
-                    resultShips = Protocol::ParseShipMessage(*clientSd, receivedMessage, size, fromServer);
-                    for(int i = ships->size()-1; i >=0; i--)
+                // Where to send datagrams from now on, port 0 if the server won't
+                case static_cast<char>(MsgType::Udp):
+                {
+                    int udpPort;
+                    memcpy(&udpPort, &message[sizeof(char)], sizeof(int));
+                    memcpy(&udpToken, &message[sizeof(char) + sizeof(int)], sizeof(int));
+                    if(udpPort == 0 || udpSd >= 0)
+                        break;
+                    sockaddr_in udpAddr;
+                    socklen_t len = sizeof(udpAddr);
+                    getpeername(*clientSd, (sockaddr*)&udpAddr, &len);
+                    udpAddr.sin_port = htons(udpPort);
+                    udpSd = socket(AF_INET, SOCK_DGRAM, 0);
+                    if(udpSd >= 0 && connect(udpSd, (sockaddr*)&udpAddr, sizeof(udpAddr)) == 0)
                     {
-                        delete ships->at(i);
-                        ships->at(i) = nullptr;
-                        ships->erase(ships->begin() + i);
+                        cerr << "Snapshots by UDP on port " << udpPort << "\n";
+                        sayHello();
+                    }
+                    else if(udpSd >= 0)
+                    {
+                        close(udpSd);
+                        udpSd = -1;
                     }
-
-                    *ships = resultShips;
                     break;
+                }
 
+                // Another player's weapons fire; nothing draws it yet
                 case static_cast<char>(MsgType::Projectiles):
+                    Protocol::ParseProjectileMessage(message, message_size, projectiles);
                     break;
 
                 default:
                     break;
             }
+        };
+
+        auto deliver = [&](const char* message, int message_size)
+        {
+            if(inbound->getDelay() > 0)
+                inbound->Push(message, message_size);
+            else
+                handleMessage(message, message_size);
+        };
+
+        // Hands on every complete message in received, leaving a partial one
+        auto deliverReceived = [&]()
+        {
+            while((receivedMessage = Protocol::NextMessage(*received, size)) != NULL)
+            {
+                deliver(receivedMessage, size);
+                received->Consume(size);
+            }
+            if(size < 0)
+            {
+                cerr << "Malformed message from server, closing the session" << endl;
+                exit(0);
+            }
+        };
+
+        // Whatever came in behind the handshake reply is already here; poll
+        // would not wake for it until the server sent something more
+        deliverReceived();
+
+        while (*chkPtr)
+        {
+            int timeout = udpSd >= 0 && !udpHeard ? UDP_HELLO_INTERVAL : -1;
+            int lagWait = inbound->MsUntilNext();
+            if(lagWait >= 0 && (timeout < 0 || lagWait < timeout))
+                timeout = lagWait;
+
+            struct pollfd fds[2] = {{*clientSd, POLLIN, 0}, {udpSd, POLLIN, 0}};
+            int ready = poll(fds, udpSd >= 0 ? 2 : 1, timeout);
+            if(ready < 0 && errno == EINTR)
+                continue;
+
+            const std::string* due;
+            while((due = inbound->Due()) != NULL)
+            {
+                handleMessage(due->data(), due->size());
+                inbound->Pop();
+            }
+            if(ready == 0)
+            {
+                if(udpSd >= 0 && !udpHeard)
+                    sayHello();
+                continue;
+            }
+
+            if(udpSd >= 0 && (fds[1].revents & POLLIN))
+            {
+                char datagram[UDP_MAX_PAYLOAD];
+                int got;
+                while((got = recv(udpSd, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0)
+                {
+                    udpHeard = true;
+                    bool snapshot = datagram[0] == static_cast<char>(MsgType::Delta) || datagram[0] == static_cast<char>(MsgType::PackedDelta);
+                    if(snapshot && Protocol::FrameLength(datagram, got) == got)
+                        deliver(datagram, got);
+                }
+            }
+            if(!(fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            // Try to receive a message from the server
+            if(received->ReadFrom(*clientSd) <= 0)
+            {
+                if(*chkPtr)
+                {
+                    cerr << "Server has quit the session" << endl;
+                    exit(0);
+                }
+                break;
+            }
+            deliverReceived();
         }
+        if(udpSd >= 0)
+            close(udpSd);
     }
 
     void setServerInfo(char* sip, int p)
@@ -308,6 +461,59 @@ public:
         port = p;
     }
 
+    // Battle to join on the server, picked during the 'C' handshake
+    void setSession(int s)
+    {
+        sessionID = s;
+    }
+
+    // Ask for snapshots by UDP; the server may say no and keep them on TCP
+    void setUdp(bool u)
+    {
+        useUdp = u;
+    }
+
+    // How far behind the newest snapshot remote ships are drawn; more rides
+    // out burstier delivery, less shows other players sooner
+    void setInterpolationDelay(int ms)
+    {
+        interpolator.setDelay(ms);
+    }
+
+    // Pretend the server is ms of round trip away: half of it on the way
+    // out, half on the way back in
+    void setLag(int ms)
+    {
+        outbound.setDelay(ms - ms / 2);
+        inbound.setDelay(ms / 2);
+    }
+
+    // Sends the 'C' handshake naming our session and waits for the server's
+    // 'C' reply carrying this client's ID
+    bool JoinSession()
+    {
+        char join_message[sizeof(char) + sizeof(int)];
+        char message_type = static_cast<char>(MsgType::ClientID);
+        memcpy(&join_message[0], &message_type, sizeof(char));
+        memcpy(&join_message[sizeof(char)], &sessionID, sizeof(int));
+        if(send(clientSd, join_message, sizeof(join_message), 0) != sizeof(join_message))
+            return false;
+
+        int size = 0;
+        const char* reply;
+        while((reply = Protocol::NextMessage(received, size)) == NULL)
+        {
+            if(size < 0 || received.ReadFrom(clientSd) <= 0)
+                return false;
+        }
+        if(reply[0] != static_cast<char>(MsgType::ClientID))
+            return false;
+        cid = Protocol::ParseClientIDMessage(reply, size);
+        received.Consume(size);
+        cerr << "Joined session " << sessionID << " as client " << cid << "\n";
+        return true;
+    }
+
     void openGame(sf::RenderWindow & window, bool local)
     {
         localGame = local;
@@ -332,17 +538,43 @@ public:
             }
             else
                 cerr << "Connected to the server!" << endl;
+            // Inputs and acks are tiny and should go out the moment they are sent
+            int one = 1;
+            setsockopt(clientSd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
 
-            cid = 0; // index for this client's DrawShip in ships vector
-
-            // Spawn the thread to check for incoming messages from the server
-            t1 = thread(checkerThread, &ships, &cid, &clientSd, &check);
+            // cid is the index for this client's DrawShip in ships vector
+            if(!JoinSession())
+            {
+                cerr << "Server did not accept the session handshake!" << endl;
+                exit(0);
+            }
+            // Ask for packed snapshots, the checker thread hears which format we got
+            char version_request[sizeof(char) + sizeof(int)] = {static_cast<char>(MsgType::WireVersion)};
+            int version = WIRE_VERSION_LATEST;
+            memcpy(&version_request[sizeof(char)], &version, sizeof(int));
+            send(clientSd, version_request, sizeof(version_request), 0);
+            if(useUdp)
+            {
+                // The reply is picked up by the checker thread
+                char udp_request[sizeof(char) + 2 * sizeof(int)] = {static_cast<char>(MsgType::Udp)};
+                send(clientSd, udp_request, sizeof(udp_request), 0);
+            }
         }
         // window logic
         window.setFramerateLimit(60);
 
-        hexGrid.setPrimitiveType(grid.GetPrimitiveType());
-        hexGrid = grid.GenerateHexGrid();
+        // Every ship and projectile image in one texture, decoded once here
+        vector<string> sprites = {
+            "./images/Sprite1ENG_ON.png", "./images/Sprite1ENG_OFF.png", "./images/Sprite1DMG_ON.png", "./images/Sprite1DMG_OFF.png",
+            "./images/Sprite2ENG_ON.png", "./images/Sprite2ENG_OFF.png", "./images/Sprite2DMG_ON.png", "./images/Sprite2DMG_OFF.png",
+            "./images/blue_Team_Projectile.png", "./images/red_Team_Projectile.png"
+        };
+        if (!shipAtlas.Load(sprites))
+            cerr << "Some ship images are missing" << endl;
+
+        hexChunks = grid.GenerateHexChunks();
+        hexRowChunks = grid.GenerateHexChunks(HEX_CHUNK_SIZE, HexDetail::Rows);
+        hexSectors = grid.GenerateHexChunks(HEX_SECTOR_SIZE, HexDetail::Sectors);
 
         camera = window.getView();
         hud = sf::View(window.getView());
@@ -358,7 +590,11 @@ public:
         hudText.setFillColor(sf::Color(255,255,255,255));
         hudText.setStyle(sf::Text::Bold);
 
-        // Create initial client ship
+        // Create initial client ship, at index cid like the server's master list.
+        // It is drawn from here until the first snapshot is published
+        vector<Ship*>& ships = shipStates.Front();
+        while(ships.size() < cid)
+            ships.push_back(new Ship());
         Ship* shp = new Ship();
         shp->setXpos(cid);
         shp->setYpos(cid);
@@ -406,12 +642,11 @@ public:
 
         if(local == false)
         {
-            int initial_message_length;
-            char * initial_message = Protocol::CrunchetizeMeCapn(cid, ships, initial_message_length); 
-            send(clientSd, initial_message, initial_message_length, 0);
+            // Spawn the thread to check for incoming messages from the server
+            t1 = thread(checkerThread, &shipStates, &cid, &clientSd, &check, &received, &prediction, &inbound, &interpolator);
 
-            delete initial_message;
-            initial_message = nullptr;
+            Protocol::CrunchetizeMeCapn(cid, ships, outMessage);
+            send(clientSd, outMessage.data(), outMessage.size(), 0);
             inputDelayTimer.restart();
         }
         else
@@ -423,9 +658,11 @@ public:
     int Run(sf::RenderWindow & window)
     {
         int selection = 1;
-        CheckDrawShips(drawShips, ships, cid);   // Make sure ship list is still up to date (might make more sense for CheckerThread to just do this? 
-
-                            // hopefully there won't be any race condition type things that happen)
+        // The newest ships the network thread has published, if any came in since
+        // the last frame. The list is ours until the next Acquire, so nothing
+        // here races the network thread, and neither side ever waits
+        shipStates.Acquire();
+        CheckDrawShips(drawShips, shipStates.Front(), cid);   // Make sure ship list is still up to date
         while (window.pollEvent(event))
         {
             if (event.type == sf::Event::Closed)
@@ -605,39 +842,34 @@ public:
             inputDelayTimer.restart();
         
 #pragma region testMovement
-            bool moved = false;
+            char buttons = 0;
+            // The server only sends ships in sensor range, so ours is found by ID
+            DrawShip* ownShip = GetOwnShip(drawShips, cid);
             if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
-            {
-                moved = true;
-                drawShips[cid]->Left();
-            }
+                buttons |= INPUT_LEFT;
             if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
-            {
-                moved = true;
-                drawShips[cid]->Right();
-            }
+                buttons |= INPUT_RIGHT;
             if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
-            {
-                moved = true;
-                drawShips[cid]->Forward(grid);
-            }
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
-            {
-                moved = true;
-                drawShips[cid]->Back(grid);
-            }
+                buttons |= INPUT_FORWARD;
+            if (ownShip != NULL && sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+                ownShip->Back(grid);
 
-            if(moved)
+            if (ownShip != NULL && buttons != 0)
             {
-                int message_length;
-                char * message = Protocol::CrunchetizeMeCapn(cid, ships, message_length); 
-                send(clientSd, message, message_length, 0);
-
-                delete message;
-                message = nullptr;
+                if (localGame)
+                    Movement::Apply(ownShip->getShip(), buttons, grid.getCols(), grid.getRows());
+                else
+                {
+                    // Move right away, without waiting for the server to
+                    // echo it; only the buttons go up, the server moves our
+                    // ship itself and the next snapshots are corrected for it
+                    char input[INPUT_MESSAGE_SIZE];
+                    Protocol::PackInputMessage(prediction.Input(ownShip->getShip(), buttons), buttons, input);
+                    outbound.Push(input, sizeof(input));
+                }
             }
             
-            if(shipSelected && selectedShipIndex != -1)
+            if(shipSelected && selectedShipIndex != -1 && selectedShipIndex < drawShips.size())
             {
                 selectedShipOverlay.setPosition(sf::Vector2f(grid.offset_to_pixel( drawShips[selectedShipIndex]->position() )));     
             }
@@ -645,10 +877,18 @@ public:
 
 #pragma endregion
 
+        // Inputs go out once any injected lag has passed (right away without)
+        const std::string* due;
+        while (localGame == false && (due = outbound.Due()) != NULL)
+        {
+            send(clientSd, due->data(), due->size(), 0);
+            outbound.Pop();
+        }
+
         window.clear();
         
         window.setView(camera);
-        window.draw(hexGrid);
+        DrawGrid(window);
         //cerr << "   -   " << drawShips.size() << " : " << ships.size() << endl;
         DrawShips(window, grid, drawShips);
         window.draw(selector);
@@ -668,7 +908,7 @@ public:
         check = false;
 
         int message_length = 0;
-        char * message;
+        char message[sizeof(char) + sizeof(int)];
         char message_type = static_cast<char>(MsgType::CloseSocket);
         memcpy(&message[message_length], &message_type, sizeof(char));
         message_length += sizeof(char);
@@ -681,12 +921,49 @@ public:
         close(clientSd);
     }
 
+    // Only the chunks of grid the camera can see, so a frame costs what is on
+    // screen rather than the size of the map. Zoomed far out, where whole
+    // outlines would be a few pixels across, only the rows are drawn, and
+    // further out still only the sector borders
+    void DrawGrid(sf::RenderWindow &window)
+    {
+        HexDetail detail = grid.DetailFor(camera, window.getSize().x);
+        vector<HexChunk>& chunks = detail == HexDetail::Sectors ? hexSectors : detail == HexDetail::Rows ? hexRowChunks : hexChunks;
+        sf::FloatRect view = ViewBounds(camera);
+        for (int i = 0; i < chunks.size(); i++)
+        {
+            if (chunks[i].bounds.intersects(view))
+                window.draw(chunks[i].vertices);
+        }
+    }
+
+    // The box around what a view shows, bigger than its size when it is turned
+    sf::FloatRect ViewBounds(const sf::View &view)
+    {
+        float angle = view.getRotation() * M_PI / 180;
+        sf::Vector2f size = view.getSize();
+        float width = fabs(size.x * cos(angle)) + fabs(size.y * sin(angle));
+        float height = fabs(size.x * sin(angle)) + fabs(size.y * cos(angle));
+        return sf::FloatRect(view.getCenter().x - width / 2, view.getCenter().y - height / 2, width, height);
+    }
+
+    // Our own ship is drawn where prediction has it, everyone else smoothed
+    // out between the snapshots either side of the interpolation delay. All
+    // the ships come out of one atlas, so they go to the window in one draw
     void DrawShips(sf::RenderWindow &window, HexGrid &grid, vector<DrawShip*> & shipList)
     {
+        ShipPose pose;
+        sf::FloatRect view = ViewBounds(camera);
+        shipBatch.Clear();
         for (int i = 0; i < shipList.size(); i++)
         {
-            shipList[i]->Draw(window, grid);
+            int id = shipList[i]->getShip()->getID();
+            if (localGame == false && id != cid && interpolator.Sample(id, pose))
+                shipList[i]->Draw(shipBatch, grid, view, pose);
+            else
+                shipList[i]->Draw(shipBatch, grid, view);
         }
+        shipBatch.Draw(window, shipAtlas.getTexture());
     }
 
     DrawShip * GetShipHere(sf::Vector2f pos, vector<DrawShip*> & shipList, int& selShpInd)
@@ -703,42 +980,77 @@ public:
         return NULL;
     }
 
-    // Properly populate the drawShip array based on the cid and the number of ships from server
-    void CheckDrawShips(vector<DrawShip*>& drawShips, vector<Ship*>& ships, int& cid)
+    DrawShip * GetOwnShip(vector<DrawShip*> & shipList, int cid)
     {
-        for (int i = drawShips.size()-1; i >= 0; i--)
+        for(int i = 0; i < shipList.size(); i++)
         {
-            delete drawShips[i];
-            drawShips[i] = nullptr;
-            drawShips.erase(drawShips.begin() + i);
+            if(shipList[i]->getShip()->getID() == cid)
+                return shipList[i];
         }
-        // Find client ship
+        return NULL;
+    }
+
+    // Properly populate the drawShip array based on the cid and the ships the server sent.
+    // DrawShips live on in drawShipsByID between frames: only ships that just
+    // showed up get a new one and only ships that have gone lose theirs, the
+    // rest are pointed at their (maybe moved) Ship and keep their sprite
+    void CheckDrawShips(vector<DrawShip*>& drawShips, vector<Ship*>& ships, int& cid)
+    {
+        checkPass++;
+        drawShips.clear();
         for(int i = 0; i < ships.size(); i++)
         {
             Ship* shp = ships[i];
-            string spriteFilename = "";
-            if(i == cid)
-                spriteFilename = "./images/Sprite1ENG_ON.png";
-            else
-                spriteFilename = "./images/Sprite2ENG_ON.png";
+            int id = shp->getID();
+            if(id < 0)
+                continue;   // a placeholder still waiting for the first snapshot
 
-            DrawShip* drawShp = new DrawShip();
-            sf::Sprite* sprt = new sf::Sprite();
-            sf::Texture* tex = new sf::Texture();
-            if (tex->loadFromFile(spriteFilename))
+            DrawShip*& drawShp = drawShipsByID[id];
+            if(drawShp == NULL)
             {
-                sprt->setTexture(*tex);
+                string spriteFilename = "";
+                if(id == cid)
+                    spriteFilename = "./images/Sprite1ENG_ON.png";
+                else
+                    spriteFilename = "./images/Sprite2ENG_ON.png";
+
+                // Every ship image is already in the atlas, loaded once in openGame
+                sf::IntRect frame = shipAtlas.getRect(spriteFilename);
+                if (frame.width == 0)
+                {
+                    drawShipsByID.erase(id);
+                    continue;
+                }
+                drawShp = new DrawShip();
+                sf::Sprite* sprt = drawShp->getSprite();
+                sprt->setTexture(shipAtlas.getTexture());
+                sprt->setTextureRect(frame);
                 sprt->setScale(0.4, 0.4);
                 sf::Vector2f origin = sprt->getOrigin();
                 origin.x = sprt->getOrigin().x + (sprt->getLocalBounds().width / 2);
                 origin.y = sprt->getOrigin().y + (sprt->getLocalBounds().height / 2);
                 sprt->setOrigin(origin);
-                origin = sf::Vector2f(sprt->getLocalBounds().height, sprt->getLocalBounds().width);
+            }
+            else if(drawShp->getLastSeen() == checkPass)
+                continue;   // the same ID twice, draw it once
+
+            drawShp->setShip(shp);
+            drawShp->setLastSeen(checkPass);
+            drawShips.push_back(drawShp);
+        }
 
-                drawShp->setSprite(sprt);
-                drawShp->setShip(shp);
-                drawShp->setTex(tex);
-                drawShips.push_back(drawShp);
+        // Whatever was not found this time has left
+        if(drawShipsByID.size() != drawShips.size())
+        {
+            for(auto it = drawShipsByID.begin(); it != drawShipsByID.end(); )
+            {
+                if(it->second->getLastSeen() != checkPass)
+                {
+                    delete it->second;
+                    it = drawShipsByID.erase(it);
+                }
+                else
+                    ++it;
             }
         }
     }
@@ -749,16 +1061,30 @@ private:
     // Game state and connection variables
     int clientSd;
     int status;
-    int cid;
+    int cid = 0;
+    int sessionID = 0;
+    bool useUdp = false;
+    RingBuffer received;
+    std::string outMessage;     // the 'S' that spawns our ship is built in here
+    Prediction prediction{BOARD_COLS, BOARD_ROWS};
+    DelayLine outbound;         // injected lag, see setLag
+    DelayLine inbound;
+    Interpolator interpolator;  // remote ships' recent positions
     thread t1;
     struct hostent* host;
 
     HexGrid grid = HexGrid(0, 0, 100, 100, 20, sf::LinesStrip);
-    std::vector<Ship*> ships;
-    vector<DrawShip*> drawShips;
+    TripleBuffer< std::vector<Ship*> > shipStates;  // network thread to render loop, see checkerThread
+    vector<DrawShip*> drawShips;            // this frame's ships, in the order the server sent them
+    unordered_map<int, DrawShip*> drawShipsByID;   // owns the DrawShips, kept from frame to frame
+    unsigned long checkPass = 0;
+    SpriteAtlas shipAtlas;      // every ship and projectile image, see openGame
+    SpriteBatch shipBatch;      // this frame's ships, drawn in one go
 
     sf::View hud;
-    sf::VertexArray hexGrid;
+    std::vector<HexChunk> hexChunks;    // the grid in blocks, only those in view get drawn
+    std::vector<HexChunk> hexRowChunks; // the same with less detail, for zooming out
+    std::vector<HexChunk> hexSectors;   // only the borders of bigger blocks, for zooming all the way out
     sf::Text hudText;
     sf::CircleShape selector = sf::CircleShape(20, 6);
 
@@ -1,256 +1,288 @@
-//Example code: A simple server side code, which echos back the received message.
-//Handle multiple socket connections with select and fd_set on Linux 
+//StarFleet game server.
+//Hosts any number of battles (sessions) at once. This thread accepts connections and
+//waits for each client's 'C' handshake naming the session it wants; the session's worker
+//thread then does all the I/O and ticking for it on its own edge-triggered epoll loop,
+//so each wakeup only costs as much as the number of sockets that are actually ready
 #include <iostream>
-#include <string.h>   //strlen 
+#include <string.h>   //strlen
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>   //close 
-#include <arpa/inet.h>    //close 
-#include <sys/types.h> 
-#include <sys/socket.h> 
+#include <unistd.h>   //close
+#include <fcntl.h>
+#include <arpa/inet.h>    //close
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
 #include <errno.h>
+#include <signal.h>
 #include <string>
-#include <sys/time.h> //FD_SET, FD_ISSET, FD_ZERO macros 
 #include <vector>
+#include <thread>
 #include <cstring>
-#include "src/Ship.h"
-#include "src/Projectile.h"
 #include "src/Protocol.h"
+#include "src/EventLoop.h"
+#include "src/Connection.h"
+#include "src/SessionManager.h"
+#include "src/ServerConfig.h"
+#include "src/Metrics.h"
 
-using namespace std;    
+using namespace std;
 
-#define TRUE   1 
-#define FALSE  0 
+#define TRUE   1
+#define FALSE  0
 #define PORT 8081
 
 enum class MsgType : char{
     ClientID = 'C',
     Ships = 'S',
     Projectiles = 'P',
+    Delta = 'D',
+    Ack = 'A',
+    Udp = 'U',
     CloseSocket = '0',
     Invalid = 'Z'
 };
 
-void UpdateMasterList(vector<Ship*> &ml, vector<Ship*> &cl, int cid);
+int SetNonBlocking(int sd);
+void RaiseFileLimit();
+bool ReadHandshake(Connection* conn, int &sessionID);
 
-int main(int argc , char *argv[])  
-{  
-    using namespace Protocol;
+int main(int argc , char *argv[])
+{
+    ServerConfig config;
+    config.numWorkers = thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--tick-hz") == 0 && i + 1 < argc)
+            config.tickHz = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            config.numWorkers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--no-interest") == 0)
+            config.interest = false;
+        else if (strcmp(argv[i], "--slow-client-kb") == 0 && i + 1 < argc)
+            config.slowClientBytes = atol(argv[++i]) * 1024;
+        else if (strcmp(argv[i], "--max-queue-kb") == 0 && i + 1 < argc)
+            config.maxQueuedBytes = atol(argv[++i]) * 1024;
+        else if (strcmp(argv[i], "--udp") == 0)
+            config.udp = true;
+        else if (strcmp(argv[i], "--udp-drop") == 0 && i + 1 < argc)
+            config.udpDropPercent = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc)
+            config.metricsPort = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--metrics-per-client") == 0)
+            config.metricsPerClient = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--tick-hz N] [--workers N] [--no-interest] [--slow-client-kb N] [--max-queue-kb N] [--udp] [--udp-drop PERCENT] [--metrics-port N] [--metrics-per-client]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    int opt = TRUE;  
+    int opt = TRUE;
     int master_socket;
-    int addrlen;
     int new_socket;
-    int client_socket[30];
-    int max_clients = 30;
-    int activity;
-    int valread;
-    int sd;
-    int numConnected;
-    int n;  
-    int max_sd;  
 
-    vector<Ship*> masterShipList;
-    int numShips = 0;
+    struct sockaddr_in address;
+    socklen_t addrlen;
+
+    RaiseFileLimit();
+
+    //a client that hangs up with snapshots still queued would otherwise take
+    //the whole server down on the next write; the write just fails instead
+    signal(SIGPIPE, SIG_IGN);
+
+    //create a master socket
+    if((master_socket = socket(AF_INET , SOCK_STREAM , 0)) < 0)
+    {
+        perror("socket failed");
+        exit(EXIT_FAILURE);
+    }
+
+    //set master socket to allow multiple connections ,
+    //this is just a good habit, it will work without this
+    if( setsockopt(master_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&opt,
+          sizeof(opt)) < 0 )
+    {
+        perror("setsockopt");
+        exit(EXIT_FAILURE);
+    }
+
+    //type of socket created
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons( PORT );
 
-    struct sockaddr_in address;  
-        
-    char buffer[1025];  //data buffer of 1K 
-        
-    //set of socket descriptors 
-    fd_set readfds;  
-        
-    //initialise all client_socket[] to 0 so not checked 
-    for (int i = 0; i < max_clients; i++)  
-    {  
-        client_socket[i] = 0;  
-    }  
-        
-    //create a master socket 
-    if((master_socket = socket(AF_INET , SOCK_STREAM , 0)) == 0)  
-    {  
-        perror("socket failed");  
-        exit(EXIT_FAILURE);  
-    }  
-    
-    //set master socket to allow multiple connections , 
-    //this is just a good habit, it will work without this 
-    if( setsockopt(master_socket, SOL_SOCKET, SO_REUSEADDR, (char *)&opt, 
-          sizeof(opt)) < 0 )  
-    {  
-        perror("setsockopt");  
-        exit(EXIT_FAILURE);  
-    }  
-    
-    //type of socket created 
-    address.sin_family = AF_INET;  
-    address.sin_addr.s_addr = INADDR_ANY;  
-    address.sin_port = htons( PORT );  
-        
     //bind the socket to localhost
-    if (bind(master_socket, (struct sockaddr *)&address, sizeof(address))<0)  
-    {  
-        perror("bind failed");  
-        exit(EXIT_FAILURE);  
-    }  
-    printf("Listener on port %d \n", PORT);  
-    
-    //try to specify maximum of 3 pending connections for the master socket 
-    if (listen(master_socket, 3) < 0)  
-    {  
-        perror("listen");  
-        exit(EXIT_FAILURE);  
-    }  
-        
-    //accept the incoming connection 
-    addrlen = sizeof(address);  
-    puts("Waiting for connections ...");  
-    numConnected = 0;
-    while(TRUE)  
-    {  
-        //clear the socket set 
-        FD_ZERO(&readfds);  
-    
-        //add master socket to set 
-        FD_SET(master_socket, &readfds);  
-        max_sd = master_socket;  
-            
-        //add child sockets to set 
-        for (int i = 0 ; i < max_clients ; i++)  
-        {  
-            //socket descriptor 
-            sd = client_socket[i];  
-                
-            //if valid socket descriptor then add to read list 
-            if(sd > 0)  
-                FD_SET( sd , &readfds);  
-                
-            //highest file descriptor number, need it for the select function 
-            if(sd > max_sd)  
-                max_sd = sd;  
-        }  
-    
-        //wait for an activity on one of the sockets , timeout is NULL , 
-        //so wait indefinitely 
-        activity = select( max_sd + 1 , &readfds , NULL , NULL , NULL);  
-        
-        if ((activity < 0) && (errno!=EINTR))  
-        {  
-            printf("select error");  
-        }  
-            
-        //If something happened on the master socket , 
-        //then its an incoming connection 
-        if (FD_ISSET(master_socket, &readfds))  
+    if (bind(master_socket, (struct sockaddr *)&address, sizeof(address))<0)
+    {
+        perror("bind failed");
+        exit(EXIT_FAILURE);
+    }
+    printf("Listener on port %d \n", PORT);
+
+    //let the kernel queue as many pending connections as it allows
+    if (listen(master_socket, SOMAXCONN) < 0 || SetNonBlocking(master_socket) < 0)
+    {
+        perror("listen");
+        exit(EXIT_FAILURE);
+    }
+
+    //the master socket is registered with a null pointer, clients still
+    //waiting on their handshake with their Connection
+    EventLoop loop;
+    if (!loop.Add(master_socket, EPOLLIN | EPOLLET, NULL))
+    {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+
+    //connections that never finish the handshake only show up here
+    Counter accepted;
+    Counter handshakes;
+    MetricsServer metricsServer;
+    if (config.metricsPort > 0)
+    {
+        Metrics().Register("starfleet_accepted_total", "Connections accepted", "", &accepted);
+        Metrics().Register("starfleet_handshakes_total", "Connections handed to a session", "", &handshakes);
+        if (!metricsServer.Start(config.metricsPort))
         {
+            perror("metrics port");
+            config.metricsPort = 0;
+        }
+    }
 
-            if ((new_socket = accept(master_socket, (struct sockaddr *)&address, (socklen_t*)&addrlen))<0)  
-            {  
-                perror("accept");  
-                exit(EXIT_FAILURE);  
-            }  
-            numConnected++;
-            //inform user of socket number - used in send and receive commands 
-            printf("New connection , socket fd is %d , ip is : %s , port : %d \n" , new_socket , inet_ntoa(address.sin_addr) , ntohs(address.sin_port));  
-            
-            //add new socket to array of sockets 
-            for (int i = 0; i < max_clients; i++)  
-            {  
-                //if position is empty 
-                if( client_socket[i] == 0 )  
-                {  
-                    client_socket[i] = new_socket;  
-                    printf("Adding to list of sockets as %d\n" , i);  
-                        
+    SessionManager sessions(config);
+    sessions.Start();
+    printf("%d worker threads", sessions.getWorkerCount());
+    if (config.tickHz > 0)
+        printf(", broadcasting at %d ticks per second", config.tickHz);
+    if (!config.interest)
+        printf(", interest filtering off");
+    if (config.udp)
+        printf(", snapshots over UDP on request");
+    if (config.udp && config.udpDropPercent > 0)
+        printf(" (dropping %d%%)", config.udpDropPercent);
+    if (config.metricsPort > 0)
+        printf(", metrics on 127.0.0.1:%d", config.metricsPort);
+    printf(" \n");
 
-                    // Send connection its clientID (TODO probably security stuff too, can send encryption or something)
-                    char* client_id_msg = new char[sizeof(int) + sizeof(char)];
-                    char msgType = 'C';
-                    memcpy(&client_id_msg[0], &msgType, sizeof(char)); 
-                    int sendIndex = numShips;
-                    memcpy(&client_id_msg[sizeof(char)], &sendIndex, sizeof(int)); 
-                    send(client_socket[i], client_id_msg, sizeof(int) + sizeof(char), 0);
-                    numShips++;
-                    cerr << numShips << " ships in master list. "<< masterShipList.size()<<"\n";
-                    break;  
-                }  
-            }  
+    puts("Waiting for connections ...");
+    while(TRUE)
+    {
+        int activity = loop.Wait(-1);
 
-        }  
-            
-        //else its some IO operation on some other socket
-        for (int i = 0; i < max_clients; i++)  
-        {  
-            sd = client_socket[i];  
-            if (FD_ISSET( sd , &readfds))  
-            {  
+        for (int e = 0; e < activity; e++)
+        {
+            Connection* conn = (Connection*)loop.getData(e);
 
-                //Check if it was for closing , and also read the 
-                //incoming message 
-                if ((valread = read( sd , buffer, 99999)) == 0)  
+            //If something happened on the master socket ,
+            //then its an incoming connection. Edge triggered, so drain the whole backlog
+            if (conn == NULL)
+            {
+                while (TRUE)
                 {
-                    //Somebody disconnected , get his OR HER details and print 
-                    getpeername(sd , (struct sockaddr*)&address , (socklen_t*)&addrlen);  
-                    printf("Host disconnected , ip %s , port %d \n" , 
-                          inet_ntoa(address.sin_addr) , ntohs(address.sin_port));  
-                    numShips--;
-                    masterShipList.pop_back();
-                    //Close the socket and mark as 0 in list for reuse 
-                    close( sd );  
-                    client_socket[i] = 0;
-                }  
-                    
-                //Echo back the message that came in to all clients
-                else
-                {  
-
-                    buffer[valread] = '\0';
-                    int fromClient;
-                    char msgType = 'Z';
-                    memcpy(&msgType, &buffer[0], sizeof(char));
-                    if(msgType == static_cast<char>(MsgType::CloseSocket))
+                    addrlen = sizeof(address);
+                    new_socket = accept(master_socket, (struct sockaddr *)&address, &addrlen);
+                    if (new_socket < 0)
                     {
-                        memcpy(&fromClient, &buffer[sizeof(char)], sizeof(int));
-                        char * msg = new char[sizeof(int)];
-                        memcpy(&msg[0], &fromClient, sizeof(int));
-                        send(client_socket[fromClient], msg, sizeof(int), 0);
-                        cerr << "Quit request from client "<<fromClient<<"\n";
+                        if (errno == EINTR)
+                            continue;
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                            perror("accept");
+                        break;
                     }
-                    else
-                    {
-                        std::vector<Ship*> clientShips = Protocol::ParseShipMessage(sd, buffer, valread, fromClient);
-                        int messageSize;
-                        UpdateMasterList(masterShipList, clientShips, fromClient);
+                    SetNonBlocking(new_socket);
+                    // Acks and snapshots are small and latency bound, don't let Nagle sit on them
+                    int one = 1;
+                    setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    accepted.Add();
 
-                        char* sendBack = Protocol::CrunchetizeMeCapn(-1, masterShipList, messageSize);
-                        
-                        for (int i = 0; i < max_clients; i++)
-                        {
-                            if (client_socket[i] != 0)
-                                send(client_socket[i] , sendBack, messageSize, 0);
-                        }
-                    }  
-                    // clear celery buffer
-                    memset(buffer, 0, sizeof(buffer));
+                    //inform user of socket number - used in send and receive commands
+                    printf("New connection , socket fd is %d , ip is : %s , port : %d \n" , new_socket , inet_ntoa(address.sin_addr) , ntohs(address.sin_port));
+
+                    Connection* client = new Connection(new_socket, address, -1);
+                    if (!loop.Add(new_socket, EPOLLIN | EPOLLRDHUP | EPOLLET, client))
+                    {
+                        perror("epoll_ctl");
+                        delete client;
+                    }
                 }
-            }  
-        }  
-    }  
+                continue;
+            }
+
+            //else the client is saying which session it wants (or gave up)
+            int sessionID = 0;
+            if (ReadHandshake(conn, sessionID))
+            {
+                loop.Remove(conn->getSocket());
+                sessions.Assign(conn, sessionID);
+                handshakes.Add();
+            }
+            else if (conn->isClosing())
+            {
+                printf("Host disconnected , ip %s , port %d \n" , conn->getIp() , conn->getPort());
+                loop.Remove(conn->getSocket());
+                delete conn;
+            }
+        }
+    }
     close(master_socket);
-    for(int i = 0; i < 30; i++)
-        close(client_socket[i]);
-        
-    return 0;  
+
+    return 0;
 }
 
-// ml - master list by reference
-// cl - client list by reference
-// cid- client id
-void UpdateMasterList(vector<Ship*> &ml, vector<Ship*> &cl, int cid)
+// Reads until the first complete message. A 'C' message names the session to join
+// and is consumed; anything else is an older client that skips the handshake, so it
+// joins session 0 and its message is left for the session to handle. Returns false
+// while still waiting, with the connection marked closing if it hung up or misbehaved
+bool ReadHandshake(Connection* conn, int &sessionID)
 {
-    // verify client (TODO) - for now, probably can be as simple as making sure no client tried to change a ship.id    
-    if(ml.size() < cid+1)
-        ml.push_back(new Ship());
-    ml[cid] = cl[cid];
+    RingBuffer& inbound = conn->getInbound();
+    while (TRUE)
+    {
+        int length;
+        const char* msg = Protocol::NextMessage(inbound, length);
+        if (msg != NULL)
+        {
+            sessionID = 0;
+            if (msg[0] == static_cast<char>(MsgType::ClientID))
+            {
+                memcpy(&sessionID, &msg[sizeof(char)], sizeof(int));
+                inbound.Consume(length);
+            }
+            return true;
+        }
+        if (length < 0)
+        {
+            conn->setClosing(true);
+            return false;
+        }
+
+        int valread = inbound.ReadFrom(conn->getSocket());
+        if (valread == 0 || (valread < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+            conn->setClosing(true);
+        if (valread <= 0)
+            return false;
+    }
+}
+
+int SetNonBlocking(int sd)
+{
+    int flags = fcntl(sd, F_GETFL, 0);
+    if (flags < 0)
+        return -1;
+    return fcntl(sd, F_SETFL, flags | O_NONBLOCK);
 }
 
+// Thousands of spectators means thousands of descriptors, more than the usual soft limit
+void RaiseFileLimit()
+{
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max)
+    {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+}
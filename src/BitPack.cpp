@@ -0,0 +1,88 @@
+#include "BitPack.h"
+
+BitWriter::BitWriter(std::string& o) : out(o)
+{
+    pending = 0;
+    pendingBits = 0;
+}
+
+void BitWriter::Write(uint32_t value, int bits)
+{
+    if(bits < 32)
+        value &= (1u << bits) - 1;
+    pending |= (uint64_t)value << pendingBits;
+    pendingBits += bits;
+    while(pendingBits >= 8)
+    {
+        out.push_back((char)(pending & 0xff));
+        pending >>= 8;
+        pendingBits -= 8;
+    }
+}
+
+void BitWriter::WriteVar(uint32_t value)
+{
+    while(true)
+    {
+        uint32_t chunk = value & ((1u << VARBITS_CHUNK) - 1);
+        value >>= VARBITS_CHUNK;
+        Write(chunk | (value ? 1u << VARBITS_CHUNK : 0), VARBITS_CHUNK + 1);
+        if(value == 0)
+            return;
+    }
+}
+
+void BitWriter::Flush()
+{
+    if(pendingBits > 0)
+        out.push_back((char)(pending & 0xff));
+    pending = 0;
+    pendingBits = 0;
+}
+
+BitReader::BitReader(const char* d, int length)
+{
+    data = (const unsigned char*)d;
+    end = data + (length > 0 ? length : 0);
+    pending = 0;
+    pendingBits = 0;
+    overrun = false;
+}
+
+uint32_t BitReader::Read(int bits)
+{
+    while(pendingBits < bits)
+    {
+        if(data == end)
+        {
+            overrun = true;
+            return 0;
+        }
+        pending |= (uint64_t)*data++ << pendingBits;
+        pendingBits += 8;
+    }
+    uint32_t value = (uint32_t)(pending & (bits < 32 ? (1ull << bits) - 1 : 0xffffffffull));
+    pending >>= bits;
+    pendingBits -= bits;
+    return value;
+}
+
+uint32_t BitReader::ReadVar()
+{
+    uint32_t value = 0;
+    for(int shift = 0; shift < 32; shift += VARBITS_CHUNK)
+    {
+        uint32_t chunk = Read(VARBITS_CHUNK + 1);
+        value |= (chunk & ((1u << VARBITS_CHUNK) - 1)) << shift;
+        if(!(chunk & (1u << VARBITS_CHUNK)) || overrun)
+            return value;
+    }
+    // More continuation bits than an int can hold
+    overrun = true;
+    return value;
+}
+
+bool BitReader::ok()
+{
+    return !overrun;
+}
@@ -0,0 +1,46 @@
+#include <string>
+#include <stdint.h>
+
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#define VARBITS_CHUNK 3     // data bits per continuation bit in WriteVar
+
+// Appends values of any width to a string, least significant bit first
+class BitWriter
+{
+private:
+    std::string& out;
+    uint64_t pending;
+    int pendingBits;
+
+public:
+    BitWriter(std::string& out);
+
+    void Write(uint32_t value, int bits);
+    // Small numbers in few bits: VARBITS_CHUNK bits at a time, each followed
+    // by a bit saying whether more follow
+    void WriteVar(uint32_t value);
+    // Pads the last byte out with zeros; call once at the end
+    void Flush();
+};
+
+// Reads what BitWriter wrote. Running off the end reads zeros and clears ok()
+class BitReader
+{
+private:
+    const unsigned char* data;
+    const unsigned char* end;
+    uint64_t pending;
+    int pendingBits;
+    bool overrun;
+
+public:
+    BitReader(const char* data, int length);
+
+    uint32_t Read(int bits);
+    uint32_t ReadVar();
+    bool ok();
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "Protocol.h"
+#include "Connection.h"
+
+Connection::Connection(int s, struct sockaddr_in addr, int cid)
+{
+    sd = s;
+    address = addr;
+    clientID = cid;
+    session = NULL;
+    closing = false;
+    ackedSequence = -1;
+    outboundOffset = 0;
+    held = 0;
+    queuedBytes = 0;
+    peakQueuedBytes = 0;
+    bytesSent = 0;
+    bytesReceived = 0;
+    skippedSnapshots = 0;
+    skippedInARow = 0;
+    udpToken = -1;
+    udpBound = false;
+    datagramsSent = 0;
+    datagramBytesSent = 0;
+    projectileBytes = 0;
+    inputSequence = 0;
+    reportedInput = 0;
+    wireVersion = WIRE_VERSION_INTS;
+    sentCounter = NULL;
+}
+
+Connection::~Connection()
+{
+    if(sd >= 0)
+        close(sd);
+}
+
+int Connection::getSocket()
+{
+    return sd;
+}
+
+int Connection::getClientID()
+{
+    return clientID;
+}
+
+void Connection::setClientID(int cid)
+{
+    clientID = cid;
+}
+
+Session* Connection::getSession()
+{
+    return session;
+}
+
+void Connection::setSession(Session* s)
+{
+    session = s;
+}
+
+const char* Connection::getIp()
+{
+    return inet_ntoa(address.sin_addr);
+}
+
+int Connection::getPort()
+{
+    return ntohs(address.sin_port);
+}
+
+RingBuffer& Connection::getInbound()
+{
+    return inbound;
+}
+
+bool Connection::isClosing()
+{
+    return closing;
+}
+
+void Connection::setClosing(bool c)
+{
+    closing = c;
+}
+
+bool Connection::Send(const SharedBuffer& message, bool more)
+{
+    if(message->empty())
+        return true;
+    outbound.push_back(message);
+    queuedBytes += message->size();
+    if(queuedBytes > peakQueuedBytes)
+        peakQueuedBytes = queuedBytes;
+    if(more)
+    {
+        held++;
+        return true;
+    }
+    // Only the newcomers can be written if nothing was waiting; otherwise we
+    // are already waiting on EPOLLOUT and keep ordering by not jumping ahead
+    bool waiting = outbound.size() > (size_t)held + 1;
+    held = 0;
+    if(waiting)
+        return true;
+    return Flush();
+}
+
+bool Connection::Send(const char* data, int length, bool more)
+{
+    return Send(std::make_shared<const std::string>(data, length), more);
+}
+
+bool Connection::Flush()
+{
+    while(!outbound.empty())
+    {
+        struct iovec iov[FLUSH_IOVECS];
+        int count = 0;
+        for(auto it = outbound.begin(); it != outbound.end() && count < FLUSH_IOVECS; ++it, ++count)
+        {
+            size_t skip = count == 0 ? outboundOffset : 0;
+            iov[count].iov_base = (void*)((*it)->data() + skip);
+            iov[count].iov_len = (*it)->size() - skip;
+        }
+
+        ssize_t sent = writev(sd, iov, count);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return false;
+        }
+        bytesSent += sent;
+        queuedBytes -= sent;
+        if(sentCounter)
+            sentCounter->Add(sent);
+
+        // Drop every message that went out whole, remember how far into the next we got
+        while(sent > 0)
+        {
+            size_t left = outbound.front()->size() - outboundOffset;
+            if((size_t)sent < left)
+            {
+                outboundOffset += sent;
+                break;
+            }
+            sent -= left;
+            outbound.pop_front();
+            outboundOffset = 0;
+        }
+    }
+    return true;
+}
+
+long Connection::getPendingBytes()
+{
+    return queuedBytes;
+}
+
+long Connection::getPeakPendingBytes()
+{
+    return peakQueuedBytes;
+}
+
+long Connection::getBytesSent()
+{
+    return bytesSent;
+}
+
+long Connection::getBytesReceived()
+{
+    return bytesReceived;
+}
+
+void Connection::CountReceived(long bytes)
+{
+    bytesReceived += bytes;
+}
+
+long Connection::getSkippedSnapshots()
+{
+    return skippedSnapshots;
+}
+
+int Connection::SkipSnapshot()
+{
+    skippedSnapshots++;
+    return ++skippedInARow;
+}
+
+int Connection::getUdpToken()
+{
+    return udpToken;
+}
+
+void Connection::setUdpToken(int token)
+{
+    udpToken = token;
+}
+
+bool Connection::isUdpBound()
+{
+    return udpBound;
+}
+
+const struct sockaddr_in& Connection::getUdpAddress()
+{
+    return udpAddress;
+}
+
+void Connection::BindUdp(const struct sockaddr_in& from)
+{
+    udpAddress = from;
+    udpBound = true;
+}
+
+long Connection::getDatagramsSent()
+{
+    return datagramsSent;
+}
+
+long Connection::getDatagramBytesSent()
+{
+    return datagramBytesSent;
+}
+
+void Connection::CountDatagram(long bytes)
+{
+    datagramsSent++;
+    datagramBytesSent += bytes;
+}
+
+long Connection::getProjectileBytes()
+{
+    return projectileBytes;
+}
+
+void Connection::CountProjectiles(long bytes)
+{
+    projectileBytes += bytes;
+}
+
+int Connection::getInputSequence()
+{
+    return inputSequence;
+}
+
+void Connection::setInputSequence(int sequence)
+{
+    inputSequence = sequence;
+}
+
+int Connection::getReportedInput()
+{
+    return reportedInput;
+}
+
+void Connection::setReportedInput(int sequence)
+{
+    reportedInput = sequence;
+}
+
+int Connection::getWireVersion()
+{
+    return wireVersion;
+}
+
+void Connection::setWireVersion(int version)
+{
+    wireVersion = version;
+}
+
+void Connection::setSentCounter(Counter* counter)
+{
+    sentCounter = counter;
+}
+
+void Connection::RememberSnapshot(const std::shared_ptr<const Snapshot>& snap)
+{
+    sent[snap->getSequence() % SNAPSHOT_HISTORY] = snap;
+    skippedInARow = 0;
+}
+
+void Connection::Acknowledge(int sequence)
+{
+    if(sequence > ackedSequence)
+        ackedSequence = sequence;
+}
+
+const Snapshot* Connection::getBaseline()
+{
+    if(ackedSequence < 0)
+        return NULL;
+    const Snapshot* base = sent[ackedSequence % SNAPSHOT_HISTORY].get();
+    // Too old, it has been overwritten since
+    if(base == NULL || base->getSequence() != ackedSequence)
+        return NULL;
+    return base;
+}
@@ -0,0 +1,134 @@
+#include <string>
+#include <memory>
+#include <deque>
+#include <netinet/in.h>
+#include "RingBuffer.h"
+#include "Snapshot.h"
+#include "Metrics.h"
+
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#define FLUSH_IOVECS 64     // buffers handed to one writev
+
+class Session;
+
+// An encoded message shared by every client it is queued for, freed once the
+// last of them has written it out
+typedef std::shared_ptr<const std::string> SharedBuffer;
+
+// Server-side state for one connected client socket. The socket is
+// non-blocking; anything the kernel will not take right away stays queued
+// (by reference, not copied) and is flushed with writev when the socket
+// becomes writable again.
+class Connection
+{
+private:
+    int sd;
+    int clientID;
+    Session* session;           // battle this client joined, NULL until the handshake
+    struct sockaddr_in address;
+
+    RingBuffer inbound;         // received bytes not yet framed into messages
+    std::deque<SharedBuffer> outbound;  // messages still waiting for the kernel
+    size_t outboundOffset;      // bytes of the front message already written
+    int held;                   // messages at the back queued with more, not written yet
+    bool closing;               // marked for removal at the end of the batch
+
+    // queue counters
+    long queuedBytes;           // currently waiting in outbound
+    long peakQueuedBytes;
+    long bytesSent;
+    long bytesReceived;
+    long skippedSnapshots;      // broadcasts not queued because the client was behind
+    int skippedInARow;          // since the last snapshot that was queued
+
+    // Snapshots recently sent here, by sequence % SNAPSHOT_HISTORY, and the
+    // newest one the client has acknowledged (-1 = none, send keyframes)
+    std::shared_ptr<const Snapshot> sent[SNAPSHOT_HISTORY];
+    int ackedSequence;
+
+    // UDP snapshot channel: the token the client says hello with, and the
+    // address the hello came from (snapshots go there once it is known)
+    int udpToken;               // -1 = TCP only
+    bool udpBound;
+    struct sockaddr_in udpAddress;
+    long datagramsSent;
+    long datagramBytesSent;
+    long projectileBytes;       // other players' 'P' bursts queued here
+
+    // Newest 'I' applied to this client's ship, and the newest one told to
+    // it in a 'K' so far
+    int inputSequence;
+    int reportedInput;
+
+    int wireVersion;            // snapshot format, WIRE_VERSION_* in Protocol.h
+
+    Counter* sentCounter;       // the worker's bytes out, NULL until adopted
+
+public:
+    Connection(int sd, struct sockaddr_in addr, int cid);
+    ~Connection();
+
+    int getSocket();
+
+    int getClientID();
+    void setClientID(int);
+
+    Session* getSession();
+    void setSession(Session*);
+
+    const char* getIp();
+    int getPort();
+
+    RingBuffer& getInbound();
+
+    bool isClosing();
+    void setClosing(bool);
+
+    // All return false when the connection has failed and should be dropped.
+    // Send queues the message behind anything already waiting and writes as
+    // much as the kernel takes right now; the raw version copies data first.
+    // With more set it only queues, and the next Send writes both in one go
+    bool Send(const SharedBuffer& message, bool more = false);
+    bool Send(const char* data, int length, bool more = false);
+    bool Flush();
+
+    long getPendingBytes();
+    long getPeakPendingBytes();
+    long getBytesSent();
+    long getBytesReceived();
+    void CountReceived(long bytes);
+    long getSkippedSnapshots();
+    // Returns how many snapshots in a row have now been skipped
+    int SkipSnapshot();
+
+    int getUdpToken();
+    void setUdpToken(int);
+    bool isUdpBound();
+    const struct sockaddr_in& getUdpAddress();
+    void BindUdp(const struct sockaddr_in& from);
+    long getDatagramsSent();
+    long getDatagramBytesSent();
+    void CountDatagram(long bytes);
+    long getProjectileBytes();
+    void CountProjectiles(long bytes);
+
+    int getInputSequence();
+    void setInputSequence(int);
+    int getReportedInput();
+    void setReportedInput(int);
+
+    int getWireVersion();
+    void setWireVersion(int);
+
+    // Everything Flush writes from now on is also added to counter
+    void setSentCounter(Counter* counter);
+
+    void RememberSnapshot(const std::shared_ptr<const Snapshot>& snap);
+    void Acknowledge(int sequence);
+    // The acknowledged snapshot to delta against, or NULL if a keyframe is needed
+    const Snapshot* getBaseline();
+};
+
+#endif
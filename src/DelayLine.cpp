@@ -0,0 +1,46 @@
+#include "DelayLine.h"
+
+using namespace std;
+
+DelayLine::DelayLine(int ms)
+{
+    delayMs = ms;
+}
+
+int DelayLine::getDelay()
+{
+    return delayMs;
+}
+
+void DelayLine::setDelay(int ms)
+{
+    delayMs = ms;
+}
+
+void DelayLine::Push(const char* data, int length)
+{
+    Entry entry;
+    entry.due = chrono::steady_clock::now() + chrono::milliseconds(delayMs);
+    entry.data.assign(data, length);
+    entries.push_back(entry);
+}
+
+const string* DelayLine::Due()
+{
+    if(entries.empty() || entries.front().due > chrono::steady_clock::now())
+        return NULL;
+    return &entries.front().data;
+}
+
+void DelayLine::Pop()
+{
+    entries.pop_front();
+}
+
+int DelayLine::MsUntilNext()
+{
+    if(entries.empty())
+        return -1;
+    auto wait = chrono::duration_cast<chrono::milliseconds>(entries.front().due - chrono::steady_clock::now()).count();
+    return wait < 0 ? 0 : (int)wait + 1;
+}
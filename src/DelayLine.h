@@ -0,0 +1,37 @@
+#include <deque>
+#include <string>
+#include <chrono>
+
+#ifndef DELAYLINE_H
+#define DELAYLINE_H
+
+// Holds messages back for a fixed time, in order, to try the game on a slow
+// link without leaving localhost
+class DelayLine
+{
+private:
+    struct Entry
+    {
+        std::chrono::steady_clock::time_point due;
+        std::string data;
+    };
+    std::deque<Entry> entries;
+    int delayMs;
+
+public:
+    DelayLine(int delayMs = 0);
+
+    int getDelay();
+    void setDelay(int ms);
+
+    void Push(const char* data, int length);
+
+    // The oldest message if its time has come, or NULL. Pop() it once handled
+    const std::string* Due();
+    void Pop();
+
+    // Until the oldest message is due, for poll() timeouts; -1 when empty
+    int MsUntilNext();
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include "EventLoop.h"
+
+EventLoop::EventLoop(int maxEvents)
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(epfd < 0)
+        perror("epoll_create1");
+    ready.resize(maxEvents > 0 ? maxEvents : 1);
+    numReady = 0;
+}
+
+EventLoop::~EventLoop()
+{
+    if(epfd >= 0)
+        close(epfd);
+}
+
+bool EventLoop::Add(int fd, unsigned int events, void* data)
+{
+    epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = data;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool EventLoop::Modify(int fd, unsigned int events, void* data)
+{
+    epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = data;
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::Remove(int fd)
+{
+    epoll_event ev; // ignored, but pre-2.6.9 kernels want non-null
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int EventLoop::Wait(int timeoutMs)
+{
+    // A full batch last time means there were probably more ready sockets
+    // than slots, so grow before asking again
+    if(numReady == (int)ready.size())
+        ready.resize(ready.size() * 2);
+
+    numReady = epoll_wait(epfd, &ready[0], ready.size(), timeoutMs);
+    if(numReady < 0)
+    {
+        if(errno != EINTR)
+            perror("epoll_wait");
+        numReady = 0;
+    }
+    return numReady;
+}
+
+void* EventLoop::getData(int i)
+{
+    return ready[i].data.ptr;
+}
+
+unsigned int EventLoop::getEvents(int i)
+{
+    return ready[i].events;
+}
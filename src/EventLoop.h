@@ -0,0 +1,33 @@
+#include <vector>
+#include <sys/epoll.h>
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+// Thin wrapper around an epoll instance. Every registered descriptor carries
+// a user pointer that is handed back with its ready events, so a wakeup only
+// ever touches the sockets that actually have something to do.
+class EventLoop
+{
+private:
+    int epfd;
+    std::vector<epoll_event> ready;
+    int numReady;
+
+public:
+    EventLoop(int maxEvents = 256);
+    ~EventLoop();
+
+    bool Add(int fd, unsigned int events, void* data);
+    bool Modify(int fd, unsigned int events, void* data);
+    void Remove(int fd);
+
+    // Blocks for at most timeoutMs (-1 = forever) and returns the number of
+    // ready descriptors, which are then read back with getData/getEvents
+    int Wait(int timeoutMs);
+
+    void* getData(int i);
+    unsigned int getEvents(int i);
+};
+
+#endif
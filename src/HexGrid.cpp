@@ -1,45 +1,196 @@
+#include <algorithm>
+#include <thread>
 #include "HexGrid.h"
 
+// Every hex is 7 vertices (corner 0 around to corner 0 again, black at both
+// ends so the jump to the next hex doesn't show), all written straight into
+// an array sized once up front. Corners are the same offsets from every
+// center, so they are worked out once, and each row is a plain loop over
+// columns. Big grids are split by rows over a few threads, each writing its
+// own part of the array
 sf::VertexArray HexGrid::GenerateHexGrid(sf::Vector2f startCoord, int r, int c, float s)
 {
-	sf::VertexArray gridVertices;
-	gridVertices.setPrimitiveType(primitiveType);
+	sf::VertexArray gridVertices(primitiveType, r > 0 && c > 0 ? (size_t)r * c * 7 : 0);
+	if (gridVertices.getVertexCount() == 0)
+		return gridVertices;
 
 	float height = s * 2;
 	float width = sqrt(3) / 2 * height;
+	float vertDist = height * 0.75;
+
+	sf::Vector2f corners[7];
+	sf::Vertex center;
+	for (int i = 0; i < 7; i++)
+		corners[i] = hexCorner(center, s, i);
+
+	sf::Vertex* vertices = &gridVertices[0];
+	auto generateRows = [=](int firstRow, int lastRow)
+	{
+		for (int row = firstRow; row < lastRow; row++)
+		{
+			float x = startCoord.x;
+			if (row & 1)
+				x -= (width / 2);
+			float y = startCoord.y + (row * vertDist);
+			sf::Vertex* out = vertices + (size_t)row * c * 7;
+			for (int col = 0; col < c; col++, out += 7)
+			{
+				float cx = x + (col * width);
+				for (int i = 0; i < 7; i++)
+				{
+					out[i].position.x = cx + corners[i].x;
+					out[i].position.y = y + corners[i].y;
+					out[i].color = sf::Color::Red;
+				}
+				out[0].color = sf::Color::Black;
+				out[6].color = sf::Color::Black;
+			}
+		}
+	};
 
+	int threads = std::min((int)std::thread::hardware_concurrency(), r);
+	if (threads <= 1 || (long)r * c < HEX_THREAD_MIN_HEXES)
+	{
+		generateRows(0, r);
+		return gridVertices;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+		workers.push_back(std::thread(generateRows, (long)r * t / threads, (long)r * (t + 1) / threads));
+	generateRows(0, r / threads);
+	for (int t = 0; t < workers.size(); t++)
+		workers[t].join();
+	return gridVertices;
+}
+
+// Chunks start on even rows so every one begins with an unshifted row, like
+// the whole grid does, and GenerateHexGrid can lay it out
+std::vector<HexChunk> HexGrid::GenerateHexChunks(int chunkSize, HexDetail detail)
+{
+	if (chunkSize < 2)
+		chunkSize = 2;
+	chunkSize += chunkSize & 1;
+
+	float height = cellSize * 2;
+	float width = sqrt(3) / 2 * height;
 	float vertDist = height * 0.75;
 
-	int curRow = 0;
-	int curCol = 0;
-	bool offsetRow = false;
-	while (curRow < r)
+	std::vector<HexChunk> chunks;
+	for (int r = 0; r < rows; r += chunkSize)
 	{
-		curCol = 0;
-		while (curCol < c)
+		for (int c = 0; c < columns; c += chunkSize)
 		{
-			sf::VertexArray newHex(primitiveType, 7);
-			sf::Vector2f thisCoord;
+			HexChunk chunk;
+			sf::Vector2f start(origin.x + c * width, origin.y + r * vertDist);
+			if (detail == HexDetail::Sectors)
+				chunk.vertices = GenerateChunkOutline(r, c, std::min(chunkSize, rows - r), std::min(chunkSize, columns - c));
+			else if (detail == HexDetail::Rows)
+				chunk.vertices = GenerateRowOutlines(r, c, std::min(chunkSize, rows - r), std::min(chunkSize, columns - c));
+			else
+				chunk.vertices = GenerateHexGrid(start, std::min(chunkSize, rows - r), std::min(chunkSize, columns - c), cellSize);
+			chunk.bounds = chunk.vertices.getBounds();
+			chunks.push_back(std::move(chunk));
+		}
+	}
+	return chunks;
+}
 
-			thisCoord.x = startCoord.x + (curCol * width);
-			if (offsetRow)
-				thisCoord.x -= (width / 2);
-			thisCoord.y = startCoord.y + (curRow * vertDist);
+// One zigzag per row over the top corners (upper left, top, ... upper right)
+// of its hexes, and one under the bottom row of the grid to close it. Two
+// vertices a hex instead of seven, and rows join with black lines like hexes do
+sf::VertexArray HexGrid::GenerateRowOutlines(int firstRow, int firstCol, int r, int c)
+{
+	sf::VertexArray vertices(primitiveType);
 
-			newHex = GenerateHex(thisCoord, s, offsetRow);
-			
-			for (int i = 0; i < newHex.getVertexCount(); i++)
+	float height = cellSize * 2;
+	float width = sqrt(3) / 2 * height;
+	float vertDist = height * 0.75;
+
+	int lastRow = firstRow + r - 1;
+	bool closeGrid = lastRow == rows - 1;
+	for (int row = firstRow; row <= lastRow + (closeGrid ? 1 : 0); row++)
+	{
+		// Past the last row, the zigzag is along the bottom of that row instead
+		bool bottom = row > lastRow;
+		int hexRow = bottom ? lastRow : row;
+		int edge[3] = {3, 4, 5};
+		if (bottom)
+		{
+			edge[0] = 2;
+			edge[1] = 1;
+			edge[2] = 0;
+		}
+
+		int rowStart = vertices.getVertexCount();
+		for (int col = firstCol; col < firstCol + c; col++)
+		{
+			sf::Vertex center;
+			center.position.x = origin.x + col * width;
+			if (hexRow & 1)
+				center.position.x -= (width / 2);
+			center.position.y = origin.y + hexRow * vertDist;
+
+			vertices.append(sf::Vertex(hexCorner(center, cellSize, edge[0]), sf::Color::Red));
+			vertices.append(sf::Vertex(hexCorner(center, cellSize, edge[1]), sf::Color::Red));
+			if (col == firstCol + c - 1)
+				vertices.append(sf::Vertex(hexCorner(center, cellSize, edge[2]), sf::Color::Red));
+		}
+		vertices[rowStart].color = sf::Color::Black;
+		vertices[vertices.getVertexCount() - 1].color = sf::Color::Black;
+	}
+	return vertices;
+}
+
+// The hex edges around a block of the grid: every edge whose hex on the far
+// side is outside the block, as separate lines. Edge i runs from corner i to
+// corner i + 1, and the hex across it is the neighbour at 60 * (i + 1) degrees
+sf::VertexArray HexGrid::GenerateChunkOutline(int firstRow, int firstCol, int r, int c)
+{
+	sf::VertexArray vertices(sf::Lines);
+
+	float height = cellSize * 2;
+	float width = sqrt(3) / 2 * height;
+	float vertDist = height * 0.75;
+
+	for (int row = firstRow; row < firstRow + r; row++)
+	{
+		// Odd rows sit half a hex left, so which column is diagonally next
+		// to a hex depends on the row it is in
+		int right = (row & 1) ? 0 : 1;
+		int left = right - 1;
+		int neighbour[6][2] = {	// row, column
+			{row + 1, right}, {row + 1, left}, {row, -1},
+			{row - 1, left}, {row - 1, right}, {row, 1} };
+		for (int col = firstCol; col < firstCol + c; col++)
+		{
+			sf::Vertex center;
+			center.position.x = origin.x + col * width;
+			if (row & 1)
+				center.position.x -= (width / 2);
+			center.position.y = origin.y + row * vertDist;
+
+			for (int i = 0; i < 6; i++)
 			{
-				gridVertices.append(newHex[i]);
+				int nRow = neighbour[i][0];
+				int nCol = col + neighbour[i][1];
+				if (nRow >= firstRow && nRow < firstRow + r && nCol >= firstCol && nCol < firstCol + c)
+					continue;
+				vertices.append(sf::Vertex(hexCorner(center, cellSize, i), sf::Color::Red));
+				vertices.append(sf::Vertex(hexCorner(center, cellSize, i + 1), sf::Color::Red));
 			}
-			
-			curCol++;
 		}
-		curRow++;
-		offsetRow = !offsetRow;
 	}
-	int num = gridVertices.getVertexCount();
-	return gridVertices;
+	return vertices;
+}
+
+HexDetail HexGrid::DetailFor(const sf::View& view, unsigned int windowWidth)
+{
+	float hexPixels = cellSize * sqrt(3) * windowWidth / view.getSize().x;
+	if (hexPixels < HEX_LOD_SECTOR_PIXELS)
+		return HexDetail::Sectors;
+	if (hexPixels < HEX_LOD_PIXELS)
+		return HexDetail::Rows;
+	return HexDetail::Cells;
 }
 
 sf::VertexArray HexGrid::GenerateHex(sf::Vector2f center, float size, bool offset = false)
@@ -1,11 +1,32 @@
 #include <SFML/Graphics.hpp>
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <vector>
 
 
 #ifndef HEXGRID_H
 #define HEXGRID_H
 
+#define HEX_CHUNK_SIZE 16	// hexes along each side of a chunk
+#define HEX_THREAD_MIN_HEXES 65536	// smaller grids are generated on one thread
+#define HEX_LOD_PIXELS 16	// hexes narrower than this on screen are drawn as Rows...
+#define HEX_LOD_SECTOR_PIXELS 10	// ...and narrower than this, as Sectors
+#define HEX_SECTOR_SIZE 64	// hexes along each side of a sector
+
+// How much of each hex to draw: the whole outline, only the zigzag along the
+// top of every row (zoomed out, where outlines blur together), or nothing but
+// the outline around each chunk (zoomed all the way out, so the lines drawn
+// no longer grow with the number of hexes in view)
+enum class HexDetail { Cells, Rows, Sectors };
+
+// A block of the grid drawn in one go, with the area it covers so blocks
+// outside the view can be skipped
+struct HexChunk
+{
+	sf::VertexArray vertices;
+	sf::FloatRect bounds;
+};
+
 class HexGrid
 {
 public:
@@ -18,6 +39,10 @@ public:
 	sf::VertexArray GenerateHex(sf::Vector2f center, float size, bool);
 	sf::VertexArray GenerateHexGrid();
 	sf::VertexArray GenerateHexGrid(sf::Vector2f, int, int, float);
+	// The same grid cut into chunkSize x chunkSize blocks, row by row
+	std::vector<HexChunk> GenerateHexChunks(int chunkSize = HEX_CHUNK_SIZE, HexDetail detail = HexDetail::Cells);
+	// The detail worth drawing through view in a window windowWidth pixels wide
+	HexDetail DetailFor(const sf::View& view, unsigned int windowWidth);
     sf::Vector2f offset_to_pixel(sf::Vector2f);
     sf::Vector2f pixel_to_offset(sf::Vector2f);
     
@@ -40,6 +65,8 @@ private:
 	float cellSize;
 
 	sf::Vector2f hexCorner(sf::Vertex center, float size, int i);
+	sf::VertexArray GenerateRowOutlines(int firstRow, int firstCol, int r, int c);
+	sf::VertexArray GenerateChunkOutline(int firstRow, int firstCol, int r, int c);
 
     sf::Vector2f hex_round(sf::Vector2f to_round);
     sf::Vector3f cube_round(sf::Vector3f to_round);
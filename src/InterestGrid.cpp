@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <stdlib.h>
+#include "InterestGrid.h"
+
+InterestGrid::InterestGrid()
+{
+    ships = NULL;
+}
+
+// Floor division, so negative coordinates land in their own buckets
+int InterestGrid::BucketOf(int coord)
+{
+    return coord >= 0 ? coord / INTEREST_BUCKET_SIZE : -((-coord - 1) / INTEREST_BUCKET_SIZE) - 1;
+}
+
+long long InterestGrid::Key(int bx, int by)
+{
+    return ((long long)bx << 32) | (unsigned int)by;
+}
+
+void InterestGrid::Rebuild(std::vector<Ship*>& list)
+{
+    ships = &list;
+
+    // Ships wander, don't let buckets they left behind pile up forever
+    if(buckets.size() > 4 * list.size() + 64)
+        buckets.clear();
+    for(auto it = buckets.begin(); it != buckets.end(); ++it)
+        it->second.clear();
+
+    for(int i = 0; i < list.size(); i++)
+    {
+        if(list[i]->getID() < 0)
+            continue;
+        buckets[Key(BucketOf(list[i]->getXpos()), BucketOf(list[i]->getYpos()))].push_back(i);
+    }
+}
+
+void InterestGrid::Query(int x, int y, int range, std::vector<int>& out) const
+{
+    out.clear();
+    if(ships == NULL || range < 0)
+        return;
+
+    // Everything within range hexes is within range + 1 offset columns and
+    // range rows, so only those buckets need an exact distance check
+    int minX = BucketOf(x - range - 1), maxX = BucketOf(x + range + 1);
+    int minY = BucketOf(y - range), maxY = BucketOf(y + range);
+    for(int bx = minX; bx <= maxX; bx++)
+    {
+        for(int by = minY; by <= maxY; by++)
+        {
+            auto it = buckets.find(Key(bx, by));
+            if(it == buckets.end())
+                continue;
+            const std::vector<int>& bucket = it->second;
+            for(int i = 0; i < bucket.size(); i++)
+            {
+                Ship* ship = (*ships)[bucket[i]];
+                if(HexDistance(x, y, ship->getXpos(), ship->getYpos()) <= range)
+                    out.push_back(bucket[i]);
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
+
+// Same even-r to cube conversion as HexGrid::offset_to_cube, in integers
+int InterestGrid::HexDistance(int x1, int y1, int x2, int y2)
+{
+    int cx1 = x1 - (y1 + (y1 & 1)) / 2;
+    int cx2 = x2 - (y2 + (y2 & 1)) / 2;
+    int dx = cx1 - cx2;
+    int dz = y1 - y2;
+    int dy = -dx - dz;
+    return std::max(abs(dx), std::max(abs(dy), abs(dz)));
+}
@@ -0,0 +1,36 @@
+#include <vector>
+#include <unordered_map>
+#include "Ship.h"
+
+#ifndef INTERESTGRID_H
+#define INTERESTGRID_H
+
+#define INTEREST_BUCKET_SIZE 8  // hexes per side of one bucket
+
+// Spatial buckets over the ship list, for finding which ships are within a
+// viewer's sensor range without checking every ship against every client.
+// Positions are the even-r offset hex coordinates the client draws with.
+class InterestGrid
+{
+private:
+    std::unordered_map<long long, std::vector<int> > buckets;  // bucket key -> ship indices
+    std::vector<Ship*>* ships;
+
+    static int BucketOf(int coord);
+    static long long Key(int bx, int by);
+
+public:
+    InterestGrid();
+
+    // Re-buckets every ship with an ID; the bucket vectors are kept between
+    // rebuilds so a steady battle does not allocate
+    void Rebuild(std::vector<Ship*>& ships);
+
+    // Fills out with the indices (ascending) of ships within range hexes of (x, y)
+    void Query(int x, int y, int range, std::vector<int>& out) const;
+
+    // Distance in hexes between two even-r offset coordinates
+    static int HexDistance(int x1, int y1, int x2, int y2);
+};
+
+#endif
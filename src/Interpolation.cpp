@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include "Interpolation.h"
+
+using namespace std;
+
+Interpolator::Track::Track()
+{
+    first = 0;
+    count = 0;
+}
+
+Interpolator::Seen& Interpolator::Track::at(int i)
+{
+    return samples[(first + i) % INTERPOLATION_SAMPLES];
+}
+
+void Interpolator::Track::Push(const Seen& s)
+{
+    if(count == INTERPOLATION_SAMPLES)
+        PopFront();
+    samples[(first + count) % INTERPOLATION_SAMPLES] = s;
+    count++;
+}
+
+void Interpolator::Track::PopFront()
+{
+    first = (first + 1) % INTERPOLATION_SAMPLES;
+    count--;
+}
+
+Interpolator::Interpolator(int ms)
+{
+    delayMs = ms;
+}
+
+int Interpolator::getDelay()
+{
+    lock_guard<mutex> guard(lock);
+    return delayMs;
+}
+
+void Interpolator::setDelay(int ms)
+{
+    lock_guard<mutex> guard(lock);
+    delayMs = ms;
+}
+
+void Interpolator::Record(const vector<Ship*>& ships)
+{
+    lock_guard<mutex> guard(lock);
+    Clock::time_point now = Clock::now();
+    for(int i = 0; i < ships.size(); i++)
+    {
+        if(ships[i]->getID() < 0)
+            continue;
+        Seen sample;
+        sample.time = now;
+        sample.x = ships[i]->getXpos();
+        sample.y = ships[i]->getYpos();
+        sample.orientation = ships[i]->getOrientation();
+        history[ships[i]->getID()].Push(sample);
+    }
+
+    // Keep one sample older than the delay to interpolate from
+    Clock::time_point oldest = now - chrono::milliseconds(delayMs + INTERPOLATION_KEEP_MS);
+    for(auto it = history.begin(); it != history.end(); )
+    {
+        Track& samples = it->second;
+        while(samples.count > 1 && samples.at(1).time < oldest)
+            samples.PopFront();
+        if(samples.at(samples.count - 1).time < oldest)
+            it = history.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool Interpolator::Sample(int id, ShipPose& pose)
+{
+    lock_guard<mutex> guard(lock);
+    auto it = history.find(id);
+    if(it == history.end())
+        return false;
+    Track& samples = it->second;
+    Clock::time_point renderTime = Clock::now() - chrono::milliseconds(delayMs);
+
+    // The last sample at or before renderTime, and the one after it. Past
+    // the newest (a late snapshot) the ship waits there rather than guess
+    int b = samples.count - 1;
+    while(b > 0 && samples.at(b).time > renderTime)
+        b--;
+    const Seen& from = samples.at(b);
+    const Seen& to = b + 1 < samples.count ? samples.at(b + 1) : from;
+
+    pose.fromX = from.x;
+    pose.fromY = from.y;
+    pose.toX = to.x;
+    pose.toY = to.y;
+    pose.t = 0;
+    if(&to != &from && renderTime > from.time)
+    {
+        double span = chrono::duration<double>(to.time - from.time).count();
+        double into = chrono::duration<double>(renderTime - from.time).count();
+        pose.t = span > 0 ? (float)(into / span) : 1;
+        if(pose.t > 1)
+            pose.t = 1;
+    }
+
+    // Jumps (spawning, coming back into sensor range) are not slid across the board
+    if(abs(to.x - from.x) > INTERPOLATION_MAX_STEP || abs(to.y - from.y) > INTERPOLATION_MAX_STEP)
+    {
+        pose.fromX = to.x;
+        pose.fromY = to.y;
+        pose.t = 1;
+    }
+
+    // Turn the short way round
+    int turn = ((to.orientation - from.orientation) % 6 + 6) % 6;
+    if(turn > 3)
+        turn -= 6;
+    pose.orientation = from.orientation + turn * pose.t;
+    return true;
+}
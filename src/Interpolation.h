@@ -0,0 +1,74 @@
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include "Ship.h"
+
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+#define DEFAULT_INTERPOLATION_DELAY 100 // ms behind the newest snapshot remote ships are drawn
+#define INTERPOLATION_KEEP_MS 1000      // history kept past the delay
+#define INTERPOLATION_MAX_STEP 2        // hexes; further than this between snapshots is a jump, not a move
+#define INTERPOLATION_SAMPLES 128       // per ship, over a second of history even at 100 snapshots a second
+
+// Where to draw a ship: t of the way from one hex to the next, and its
+// heading in (fractional) 60 degree steps
+struct ShipPose
+{
+    int fromX, fromY;
+    int toX, toY;
+    float t;
+    float orientation;
+};
+
+// Jitter buffer for remote ships. Every snapshot is recorded with the time it
+// arrived, and ships are drawn a fixed delay in the past, in between the two
+// snapshots either side of that moment. Snapshots arriving in bursts or a
+// little late then still give smooth movement, at the cost of the delay.
+// Snapshots are recorded by the network thread and sampled by the render thread.
+class Interpolator
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Seen
+    {
+        Clock::time_point time;
+        int x, y;
+        int orientation;
+    };
+
+    // Oldest first, in a fixed ring so recording a snapshot never allocates;
+    // when it fills up the oldest sample goes
+    struct Track
+    {
+        Seen samples[INTERPOLATION_SAMPLES];
+        int first;
+        int count;
+
+        Track();
+        Seen& at(int i);
+        void Push(const Seen& s);
+        void PopFront();
+    };
+
+    std::mutex lock;
+    std::unordered_map<int, Track> history;   // by ship ID
+    int delayMs;
+
+public:
+    Interpolator(int delayMs = DEFAULT_INTERPOLATION_DELAY);
+
+    int getDelay();
+    void setDelay(int ms);
+
+    // A snapshot just arrived with these ships; ships left out of it are
+    // forgotten once their history runs out
+    void Record(const std::vector<Ship*>& ships);
+
+    // False if ship id has never been recorded
+    bool Sample(int id, ShipPose& pose);
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "Metrics.h"
+
+using namespace std;
+
+Counter::Counter() : value(0)
+{
+}
+
+void Counter::Add(long n)
+{
+    value.fetch_add(n, memory_order_relaxed);
+}
+
+long Counter::get() const
+{
+    return value.load(memory_order_relaxed);
+}
+
+Gauge::Gauge() : value(0)
+{
+}
+
+void Gauge::Set(long v)
+{
+    value.store(v, memory_order_relaxed);
+}
+
+void Gauge::Add(long n)
+{
+    value.fetch_add(n, memory_order_relaxed);
+}
+
+long Gauge::get() const
+{
+    return value.load(memory_order_relaxed);
+}
+
+const double Histogram::bounds[HISTOGRAM_BUCKETS - 1] = {
+    5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+
+Histogram::Histogram() : count(0), sumNs(0)
+{
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        buckets[i].store(0, memory_order_relaxed);
+}
+
+void Histogram::Observe(double us)
+{
+    int b = 0;
+    while(b < HISTOGRAM_BUCKETS - 1 && us > bounds[b])
+        b++;
+    buckets[b].fetch_add(1, memory_order_relaxed);
+    count.fetch_add(1, memory_order_relaxed);
+    sumNs.fetch_add((long)(us * 1000), memory_order_relaxed);
+}
+
+long Histogram::getBucket(int i) const
+{
+    return buckets[i].load(memory_order_relaxed);
+}
+
+long Histogram::getCount() const
+{
+    return count.load(memory_order_relaxed);
+}
+
+double Histogram::getSumUs() const
+{
+    return sumNs.load(memory_order_relaxed) / 1000.0;
+}
+
+ScopedTimer::ScopedTimer(Histogram& h) : histogram(h), start(chrono::steady_clock::now())
+{
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    histogram.Observe(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+}
+
+// {labels}, or {labels,extra}, or nothing at all when both are empty
+static string LabelSet(const string& labels, const string& extra)
+{
+    if(labels.empty() && extra.empty())
+        return "";
+    if(labels.empty() || extra.empty())
+        return "{" + labels + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+MetricsRegistry& Metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Family& MetricsRegistry::getFamily(const string& name, const string& help, const string& type)
+{
+    Family& family = families[name];
+    family.help = help;
+    family.type = type;
+    return family;
+}
+
+void MetricsRegistry::Register(const string& name, const string& help, const string& labels, const Counter* c)
+{
+    lock_guard<mutex> guard(lock);
+    getFamily(name, help, "counter").series.push_back(make_pair(labels, (const void*)c));
+}
+
+void MetricsRegistry::Register(const string& name, const string& help, const string& labels, const Gauge* g)
+{
+    lock_guard<mutex> guard(lock);
+    getFamily(name, help, "gauge").series.push_back(make_pair(labels, (const void*)g));
+}
+
+void MetricsRegistry::Register(const string& name, const string& help, const string& labels, const Histogram* h)
+{
+    lock_guard<mutex> guard(lock);
+    getFamily(name, help, "histogram").series.push_back(make_pair(labels, (const void*)h));
+}
+
+void MetricsRegistry::AddCollector(const string& name, const string& help, const string& type,
+    function<void(const string&, string&)> collector)
+{
+    lock_guard<mutex> guard(lock);
+    getFamily(name, help, type).collectors.push_back(collector);
+}
+
+void MetricsRegistry::Render(string& out)
+{
+    lock_guard<mutex> guard(lock);
+    char line[512];
+    for(auto it = families.begin(); it != families.end(); ++it)
+    {
+        const string& name = it->first;
+        Family& family = it->second;
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + family.type + "\n";
+
+        for(int i = 0; i < family.series.size(); i++)
+        {
+            string labels = LabelSet(family.series[i].first, "");
+            const void* metric = family.series[i].second;
+            if(family.type == "counter")
+                snprintf(line, sizeof(line), "%s%s %ld\n", name.c_str(), labels.c_str(), ((const Counter*)metric)->get());
+            else if(family.type == "gauge")
+                snprintf(line, sizeof(line), "%s%s %ld\n", name.c_str(), labels.c_str(), ((const Gauge*)metric)->get());
+            else
+            {
+                // Prometheus buckets are cumulative
+                const Histogram* h = (const Histogram*)metric;
+                long cumulative = 0;
+                char le[32];
+                for(int b = 0; b < HISTOGRAM_BUCKETS; b++)
+                {
+                    cumulative += h->getBucket(b);
+                    if(b < HISTOGRAM_BUCKETS - 1)
+                        snprintf(le, sizeof(le), "le=\"%g\"", Histogram::bounds[b]);
+                    else
+                        snprintf(le, sizeof(le), "le=\"+Inf\"");
+                    snprintf(line, sizeof(line), "%s_bucket%s %ld\n", name.c_str(), LabelSet(family.series[i].first, le).c_str(), cumulative);
+                    out += line;
+                }
+                snprintf(line, sizeof(line), "%s_sum%s %.3f\n%s_count%s %ld\n", name.c_str(), labels.c_str(), h->getSumUs(),
+                    name.c_str(), labels.c_str(), h->getCount());
+            }
+            out += line;
+        }
+        for(int i = 0; i < family.collectors.size(); i++)
+            family.collectors[i](name, out);
+    }
+}
+
+MetricsServer::MetricsServer()
+{
+    listenSd = -1;
+}
+
+MetricsServer::~MetricsServer()
+{
+    if(thread.joinable())
+        thread.detach();
+}
+
+bool MetricsServer::Start(int port)
+{
+    listenSd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(listenSd < 0)
+        return false;
+    int opt = 1;
+    setsockopt(listenSd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if(bind(listenSd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenSd, 16) < 0)
+    {
+        close(listenSd);
+        listenSd = -1;
+        return false;
+    }
+    thread = std::thread(&MetricsServer::Run, this);
+    return true;
+}
+
+// One scrape at a time is plenty for a local endpoint. Whatever the request
+// says (if anything, nc sends nothing) the answer is the whole page
+void MetricsServer::Run()
+{
+    while(true)
+    {
+        int sd = accept(listenSd, NULL, NULL);
+        if(sd < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("metrics accept");
+            return;
+        }
+
+        // Read the request so closing does not reset the connection under the reply
+        struct timeval timeout = {0, 200000};
+        setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        string request;
+        char buf[1024];
+        while(request.find("\r\n\r\n") == string::npos && request.size() < 8192)
+        {
+            int got = read(sd, buf, sizeof(buf));
+            if(got <= 0)
+                break;
+            request.append(buf, got);
+        }
+
+        string body;
+        Metrics().Render(body);
+        string reply = request.compare(0, 4, "GET ") == 0
+            ? "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + to_string(body.size()) + "\r\n\r\n" + body
+            : body;
+
+        const char* data = reply.data();
+        size_t left = reply.size();
+        while(left > 0)
+        {
+            ssize_t sent = send(sd, data, left, MSG_NOSIGNAL);
+            if(sent < 0 && errno == EINTR)
+                continue;
+            if(sent <= 0)
+                break;
+            data += sent;
+            left -= sent;
+        }
+        close(sd);
+    }
+}
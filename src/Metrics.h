@@ -0,0 +1,122 @@
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#define HISTOGRAM_BUCKETS 16    // upper bounds in microseconds, the last one is +Inf
+
+// Server metrics, exported in the Prometheus text format. Every metric is
+// a few relaxed atomics, and each worker registers its own set (labelled
+// worker="N"), so recording one never takes a lock or shares a cache line
+// with another thread.
+class Counter
+{
+private:
+    std::atomic<long> value;
+
+public:
+    Counter();
+    void Add(long n = 1);
+    long get() const;
+};
+
+class Gauge
+{
+private:
+    std::atomic<long> value;
+
+public:
+    Gauge();
+    void Set(long v);
+    void Add(long n);
+    long get() const;
+};
+
+// Latencies in microseconds, in fixed exponential buckets
+class Histogram
+{
+private:
+    std::atomic<long> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<long> count;
+    std::atomic<long> sumNs;
+
+public:
+    static const double bounds[HISTOGRAM_BUCKETS - 1];
+
+    Histogram();
+    void Observe(double us);
+    long getBucket(int i) const;
+    long getCount() const;
+    double getSumUs() const;
+};
+
+// Observes the time from construction to destruction
+class ScopedTimer
+{
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    ScopedTimer(Histogram& h);
+    ~ScopedTimer();
+};
+
+class MetricsRegistry
+{
+private:
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::vector< std::pair<std::string, const void*> > series;    // labels, metric
+        std::vector< std::function<void(const std::string&, std::string&)> > collectors;
+    };
+
+    std::mutex lock;
+    std::map<std::string, Family> families;
+
+    Family& getFamily(const std::string& name, const std::string& help, const std::string& type);
+
+public:
+    // The metric must outlive the registry; labels look like worker="0"
+    void Register(const std::string& name, const std::string& help, const std::string& labels, const Counter* c);
+    void Register(const std::string& name, const std::string& help, const std::string& labels, const Gauge* g);
+    void Register(const std::string& name, const std::string& help, const std::string& labels, const Histogram* h);
+
+    // For series that come and go (per client). The collector is called with
+    // the family name and appends complete sample lines
+    void AddCollector(const std::string& name, const std::string& help, const std::string& type,
+        std::function<void(const std::string&, std::string&)> collector);
+
+    void Render(std::string& out);
+};
+
+MetricsRegistry& Metrics();
+
+// Serves Metrics().Render() on a local TCP port from its own thread, to
+// anything that connects: curl, Prometheus, or plain nc
+class MetricsServer
+{
+private:
+    int listenSd;
+    std::thread thread;
+
+    void Run();
+
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    // Listens on 127.0.0.1 only; returns false if the port is taken
+    bool Start(int port);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "Movement.h"
+
+bool Movement::Forward(Ship* ship, int cols, int rows)
+{
+    int x = ship->getXpos();
+    int y = ship->getYpos();
+    int lastCol = cols - 1;
+    int lastRow = rows - 1;
+    // Odd rows are shifted half a hex left (see HexGrid::offset_to_pixel), so
+    // which column the diagonal neighbours are in depends on the row
+    bool even = y % 2 == 0;
+    switch(ship->getOrientation())
+    {
+        case EAST:
+            if(x == lastCol)
+                return false;
+            x++;
+            break;
+
+        case NORTHEAST:
+            if((x == lastCol && even) || y == 0)
+                return false;
+            if(even)
+                x++;
+            y--;
+            break;
+
+        case NORTHWEST:
+            if((x == 0 && !even) || y == 0)
+                return false;
+            if(!even)
+                x--;
+            y--;
+            break;
+
+        case WEST:
+            if(x == 0)
+                return false;
+            x--;
+            break;
+
+        case SOUTHWEST:
+            if((x == 0 && !even) || y == lastRow)
+                return false;
+            if(!even)
+                x--;
+            y++;
+            break;
+
+        case SOUTHEAST:
+            if((x == lastCol && even) || y == lastRow)
+                return false;
+            if(even)
+                x++;
+            y++;
+            break;
+    }
+    ship->setXpos(x);
+    ship->setYpos(y);
+    return true;
+}
+
+void Movement::Right(Ship* ship)
+{
+    if(ship->getOrientation() == 5)
+        ship->setOrientation((Orientation)0);
+    else
+        ship->setOrientation((Orientation)((int)ship->getOrientation() + 1));
+}
+
+void Movement::Left(Ship* ship)
+{
+    if(ship->getOrientation() == 0)
+        ship->setOrientation((Orientation)5);
+    else
+        ship->setOrientation((Orientation)((int)ship->getOrientation() - 1));
+}
+
+void Movement::Apply(Ship* ship, int buttons, int cols, int rows)
+{
+    if(buttons & INPUT_LEFT)
+        Left(ship);
+    if(buttons & INPUT_RIGHT)
+        Right(ship);
+    if(buttons & INPUT_FORWARD)
+        Forward(ship, cols, rows);
+}
@@ -0,0 +1,31 @@
+#include "Ship.h"
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#define BOARD_COLS 100  // the board every client draws, HexGrid(0, 0, 100, 100, ...)
+#define BOARD_ROWS 100
+
+// Buttons in an 'I' message. Weapons fire is not one of them: shots go out
+// as 'P' bursts, which the server relays as they are
+#define INPUT_LEFT      0x01
+#define INPUT_RIGHT     0x02
+#define INPUT_FORWARD   0x04
+
+// How ships move on the even-r offset hex board. The client predicts with
+// these and the server applies players' 'I' messages with them, so both
+// always agree on where a ship ends up
+namespace Movement
+{
+    // One hex ahead; returns false (and stays put) at the edge of the board
+    bool Forward(Ship* ship, int cols, int rows);
+    // One 60 degree step
+    void Right(Ship* ship);
+    void Left(Ship* ship);
+
+    // Everything held down in one input, in the order the client reads the
+    // keys: turns first, then forward
+    void Apply(Ship* ship, int buttons, int cols, int rows);
+}
+
+#endif
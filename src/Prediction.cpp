@@ -0,0 +1,52 @@
+#include "Movement.h"
+#include "Prediction.h"
+
+Prediction::Prediction(int c, int r)
+{
+    cols = c;
+    rows = r;
+    nextSequence = 1;
+    acked = 0;
+    ackSnapshot = -1;
+    ackInput = 0;
+}
+
+int Prediction::Input(Ship* ship, int buttons)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Movement::Apply(ship, buttons, cols, rows);
+    int sequence = nextSequence++;
+    pending.push_back(std::make_pair(sequence, buttons));
+    if(pending.size() > PREDICTION_HISTORY)
+        pending.pop_front();
+    return sequence;
+}
+
+void Prediction::Acknowledge(int snapshotSequence, int inputSequence)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if(inputSequence < ackInput)
+        return;
+    ackSnapshot = snapshotSequence;
+    ackInput = inputSequence;
+}
+
+void Prediction::Reconcile(Ship* ship, int snapshotSequence)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    // The 'K' goes out right before the snapshot it is about; by UDP the
+    // snapshot can overtake it, and then the previous 'K' is the best we know
+    if(ackSnapshot >= 0 && ackSnapshot <= snapshotSequence && ackInput > acked)
+        acked = ackInput;
+    while(!pending.empty() && pending.front().first <= acked)
+        pending.pop_front();
+
+    for(auto it = pending.begin(); it != pending.end(); ++it)
+        Movement::Apply(ship, it->second, cols, rows);
+}
+
+int Prediction::getPendingCount()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return pending.size();
+}
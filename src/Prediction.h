@@ -0,0 +1,45 @@
+#include <deque>
+#include <mutex>
+#include <utility>
+#include "Ship.h"
+
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#define PREDICTION_HISTORY 256  // inputs kept waiting for the server; older ones are given up on
+
+// Client-side prediction for our own ship. Inputs move the ship as soon as
+// they are made and are kept, numbered, until the server says ('K') that a
+// snapshot includes them. Every snapshot that arrives in the meantime is
+// corrected by replaying the inputs it does not include yet on top of it, so
+// our ship never jumps back to where the server last saw it.
+// Inputs come from the render thread and snapshots from the network thread.
+class Prediction
+{
+private:
+    std::mutex lock;
+    std::deque< std::pair<int, int> > pending;  // sequence, buttons
+    int nextSequence;
+    int acked;              // newest input a snapshot we applied includes
+    int ackSnapshot;        // the newest 'K': from this snapshot on...
+    int ackInput;           // ...the server has applied inputs up to here
+    int cols;
+    int rows;
+
+public:
+    Prediction(int cols, int rows);
+
+    // Moves ship by buttons now and returns the sequence number to send them with
+    int Input(Ship* ship, int buttons);
+
+    // From a 'K' message
+    void Acknowledge(int snapshotSequence, int inputSequence);
+
+    // ship is our own ship out of snapshot snapshotSequence; puts it where
+    // our inputs since will have taken it
+    void Reconcile(Ship* ship, int snapshotSequence);
+
+    int getPendingCount();
+};
+
+#endif
@@ -3,12 +3,20 @@
 
 Projectile::Projectile()
 {
+    roll = 0;
     x_pos = 0;
     y_pos = 0;
+    damage = 0;
+    orientation = PEAST;
 }
 
-Projectile::Projectile(int roll, int x_pos, int y_pos, POrientation orientation)
+Projectile::Projectile(int r, int x, int y, POrientation o)
 {
+    roll = r;
+    x_pos = x;
+    y_pos = y;
+    damage = 0;
+    orientation = o;
 }
 // mutators and accessors
 int Projectile::getRoll()
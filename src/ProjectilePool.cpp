@@ -0,0 +1,142 @@
+#include "ProjectilePool.h"
+
+ProjectilePool::ProjectilePool(int capacity)
+{
+    count = 0;
+    Reserve(capacity);
+}
+
+void ProjectilePool::Reserve(int n)
+{
+    if(n <= getCapacity())
+        return;
+    xs.resize(n);
+    ys.resize(n);
+    rolls.resize(n);
+    damages.resize(n);
+    orientations.resize(n);
+}
+
+void ProjectilePool::Clear()
+{
+    count = 0;
+}
+
+void ProjectilePool::Resize(int n)
+{
+    // Doubling, so a pool filled one at a time still grows only now and then
+    if(n > getCapacity())
+        Reserve(n > 2 * getCapacity() ? n : 2 * getCapacity());
+    count = n;
+}
+
+int ProjectilePool::Add(int x, int y, int roll, int damage, POrientation orientation)
+{
+    int i = count;
+    Resize(count + 1);
+    xs[i] = x;
+    ys[i] = y;
+    rolls[i] = roll;
+    damages[i] = damage;
+    orientations[i] = (char)orientation;
+    return i;
+}
+
+int ProjectilePool::Add(Projectile& p)
+{
+    return Add(p.getX_pos(), p.getY_pos(), p.getRoll(), p.getDamage(), p.getOrientation());
+}
+
+int ProjectilePool::getCount() const
+{
+    return count;
+}
+
+int ProjectilePool::getCapacity() const
+{
+    return xs.size();
+}
+
+int ProjectilePool::getX(int i) const
+{
+    return xs[i];
+}
+
+int ProjectilePool::getY(int i) const
+{
+    return ys[i];
+}
+
+int ProjectilePool::getRoll(int i) const
+{
+    return rolls[i];
+}
+
+int ProjectilePool::getDamage(int i) const
+{
+    return damages[i];
+}
+
+POrientation ProjectilePool::getOrientation(int i) const
+{
+    return (POrientation)orientations[i];
+}
+
+void ProjectilePool::CopyTo(int i, Projectile& p) const
+{
+    p.setX_pos(xs[i]);
+    p.setY_pos(ys[i]);
+    p.setRoll(rolls[i]);
+    p.setDamage(damages[i]);
+    p.setOrientation(getOrientation(i));
+}
+
+int* ProjectilePool::getXs()
+{
+    return xs.data();
+}
+
+int* ProjectilePool::getYs()
+{
+    return ys.data();
+}
+
+int* ProjectilePool::getRolls()
+{
+    return rolls.data();
+}
+
+int* ProjectilePool::getDamages()
+{
+    return damages.data();
+}
+
+char* ProjectilePool::getOrientations()
+{
+    return orientations.data();
+}
+
+const int* ProjectilePool::getXs() const
+{
+    return xs.data();
+}
+
+const int* ProjectilePool::getYs() const
+{
+    return ys.data();
+}
+
+const int* ProjectilePool::getRolls() const
+{
+    return rolls.data();
+}
+
+const int* ProjectilePool::getDamages() const
+{
+    return damages.data();
+}
+
+const char* ProjectilePool::getOrientations() const
+{
+    return orientations.data();
+}
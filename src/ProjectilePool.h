@@ -0,0 +1,59 @@
+#include <vector>
+#include "Projectile.h"
+
+#ifndef PROJECTILEPOOL_H
+#define PROJECTILEPOOL_H
+
+#define PROJECTILE_POOL_DEFAULT 1024    // room made up front; the pool grows past it if it has to
+
+// Projectiles stored column by column (struct of arrays) instead of one
+// object each. A burst of hundreds goes on the wire as one memcpy per column
+// and comes off it the same way, straight into storage that is reused from
+// message to message, so nothing is allocated per projectile
+class ProjectilePool
+{
+private:
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<int> rolls;
+    std::vector<int> damages;
+    std::vector<char> orientations;
+    int count;
+
+public:
+    ProjectilePool(int capacity = PROJECTILE_POOL_DEFAULT);
+
+    // Makes room for n without dropping what is there
+    void Reserve(int n);
+    // Empties the pool, keeping its storage
+    void Clear();
+    // Sets the count, leaving new slots to be filled in by the caller
+    void Resize(int n);
+
+    int Add(int x, int y, int roll, int damage, POrientation orientation);
+    int Add(Projectile& p);
+
+    int getCount() const;
+    int getCapacity() const;
+
+    int getX(int i) const;
+    int getY(int i) const;
+    int getRoll(int i) const;
+    int getDamage(int i) const;
+    POrientation getOrientation(int i) const;
+    void CopyTo(int i, Projectile& p) const;
+
+    // Columns, getCount() long, for bulk reads and writes
+    int* getXs();
+    int* getYs();
+    int* getRolls();
+    int* getDamages();
+    char* getOrientations();
+    const int* getXs() const;
+    const int* getYs() const;
+    const int* getRolls() const;
+    const int* getDamages() const;
+    const char* getOrientations() const;
+};
+
+#endif
@@ -6,12 +6,74 @@
 #include "Ship.h"
 #include "Projectile.h"
 #include "Protocol.h"
+#include "ShipRecord.h"
 
 using namespace std;
 
-#define SHIP_INTS (18) // up this when stuff added
+int Protocol::FrameLength(const char* header, int available)
+{
+    if(available < (int)sizeof(char))
+        return 0;
+
+    switch(header[0])
+    {
+        // type + client id / sequence number / wire version
+        case 'C':
+        case '0':
+        case 'A':
+        case 'V':
+            return sizeof(char) + sizeof(int);
+
+        // type + UDP port + token, type + snapshot + input sequence
+        case 'U':
+        case 'K':
+            return sizeof(char) + 2 * sizeof(int);
+
+        // type + input sequence + buttons
+        case 'I':
+            return INPUT_MESSAGE_SIZE;
+
+        // type + total length + body
+        case 'S':
+        case 'P':
+        case 'D':
+        case 'Q':
+        {
+            if(available < (int)(sizeof(char) + sizeof(int)))
+                return 0;
+            int message_length = 0;
+            memcpy(&message_length, &header[sizeof(char)], sizeof(int));
+            if(message_length < (int)(sizeof(char) + sizeof(int)) || message_length > MAX_MESSAGE_SIZE)
+                return -1;
+            return message_length;
+        }
+
+        default:
+            return -1;
+    }
+}
+
+const char* Protocol::NextMessage(RingBuffer& in, int& length)
+{
+    char header[sizeof(char) + sizeof(int)];
+    int available = in.size();
+    int peek = available < (int)sizeof(header) ? available : sizeof(header);
+    in.Peek(header, 0, peek);
+
+    length = FrameLength(header, peek);
+    if(length <= 0)
+        return NULL;
+    if(length > available)
+    {
+        // Make room for the rest of it so the next read can finish the message
+        in.Reserve(length - available);
+        length = 0;
+        return NULL;
+    }
+    return in.Front(length);
+}
 
-int Protocol::ParseClientIDMessage(char * message, int message_size)
+int Protocol::ParseClientIDMessage(const char * message, int message_size)
 {
     int message_index = 0;
     char message_type = 'Z';
@@ -24,9 +86,14 @@ int Protocol::ParseClientIDMessage(char * message, int message_size)
     return cid;
 }
 
-std::vector<Ship*> Protocol::ParseShipMessage(int sd, char * message, int message_size, int &clientID)
+std::vector<Ship*> Protocol::ParseShipMessage(int sd, const char * message, int message_size, int &clientID)
 {
     std::vector<Ship*> shipArray;
+    clientID = -1;
+    // too short to even say how many ships; FrameLength lets 'S' through from 5 bytes
+    if(message_size < (int)SHIP_HEADER_SIZE)
+        return shipArray;
+
     int message_index = 0;
     char message_type = 'Z';
     memcpy(&message_type, &message[message_index], sizeof(char));
@@ -44,89 +111,83 @@ std::vector<Ship*> Protocol::ParseShipMessage(int sd, char * message, int messag
     int numberOfShips = 1;
     memcpy(&numberOfShips, &message[message_index], sizeof(int));
     message_index += sizeof(int);
+
+    // never trust the count past what actually arrived
+    int fits = (message_size - message_index) / (int)(sizeof(int) * SHIP_INTS);
+    if(numberOfShips < 0)
+        numberOfShips = 0;
+    if(numberOfShips > fits)
+        numberOfShips = fits;
     
     for(int i = 0; i < numberOfShips; i++)
     {
-        Ship* thisShip = new Ship();
-
-        // 0:   ID
-        int val;
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setID(val);
-    
-        // 1:   X pos
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setXpos(val);
-
-        // 2:   Y pos
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setYpos(val);
-
-        // 3:  orientation 
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setOrientation( (Orientation) val);
-
-        // 4:   HP cur
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setHullPointsCur(val);
-
-        // 5; HP max
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setHullPointsMax(val);
-
-        // 6:   target lock
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setTargetLock(val);
-
-        // 7; Armour Class
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setArmourClass(val);
-
-        // 8:   attack bonus
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setAttackBonus(val); // attack bonus
-
-        for(int j = 0; j < 4; j++)
-        {
-            memcpy(&val, &message[message_index], sizeof(int));
-            message_index += sizeof(int);
-            thisShip->setShieldCur((Shield)j, val);
-
-            memcpy(&val, &message[message_index], sizeof(int));
-            message_index += sizeof(int);
-            thisShip->setShieldMax((Shield)j, val);
-        }
-        
-        memcpy(&val, &message[message_index], sizeof(int));
-        message_index += sizeof(int);
-        thisShip->setOwner(val);
+        int record[SHIP_INTS];
+        memcpy(record, &message[message_index], sizeof(record));
+        message_index += sizeof(record);
 
+        Ship* thisShip = new Ship();
+        UnpackShip(record, thisShip);
         shipArray.push_back(thisShip);
-
     }
     return shipArray;
 }
 
-std::vector<Projectile*> Protocol::ParseProjectileMessage(char* message)
+bool Protocol::ParseProjectileMessage(const char* message, int message_size, ProjectilePool& pool)
+{
+    pool.Clear();
+    if(message_size < (int)PROJECTILE_HEADER_SIZE || message[0] != 'P')
+        return false;
+    int count;
+    memcpy(&count, &message[sizeof(char) + sizeof(int)], sizeof(int));
+    if(count < 0 || count > (message_size - (int)PROJECTILE_HEADER_SIZE) / (int)PROJECTILE_BYTES
+        || message_size != (int)(PROJECTILE_HEADER_SIZE + count * PROJECTILE_BYTES))
+        return false;
+
+    pool.Resize(count);
+    const char* column = &message[PROJECTILE_HEADER_SIZE];
+    memcpy(pool.getXs(), column, count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(pool.getYs(), column, count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(pool.getRolls(), column, count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(pool.getDamages(), column, count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(pool.getOrientations(), column, count);
+    return true;
+}
+
+void Protocol::PackInputMessage(int sequence, char buttons, char* out)
 {
-    std::vector<Projectile*> projectiles;
+    out[0] = 'I';
+    memcpy(&out[sizeof(char)], &sequence, sizeof(int));
+    out[sizeof(char) + sizeof(int)] = buttons;
+}
 
-    return projectiles;
+void Protocol::ParseInputMessage(const char* message, int& sequence, char& buttons)
+{
+    memcpy(&sequence, &message[sizeof(char)], sizeof(int));
+    buttons = message[sizeof(char) + sizeof(int)];
 }
 
-char * Protocol::CrunchetizeMeCapn(int clientID, std::vector<Ship*> shipArr, int &message_size)
+void Protocol::PackInputAck(int snapshotSequence, int inputSequence, char* out)
 {
-    message_size = sizeof(char) + sizeof(int) + sizeof(int) + sizeof(int) + (shipArr.size() * (sizeof(int) * SHIP_INTS));
-    char* message = new char[message_size];
+    out[0] = 'K';
+    memcpy(&out[sizeof(char)], &snapshotSequence, sizeof(int));
+    memcpy(&out[sizeof(char) + sizeof(int)], &inputSequence, sizeof(int));
+}
+
+void Protocol::ParseInputAck(const char* message, int& snapshotSequence, int& inputSequence)
+{
+    memcpy(&snapshotSequence, &message[sizeof(char)], sizeof(int));
+    memcpy(&inputSequence, &message[sizeof(char) + sizeof(int)], sizeof(int));
+}
+
+void Protocol::CrunchetizeMeCapn(int clientID, const std::vector<Ship*>& shipArr, std::string& out)
+{
+    int message_size = sizeof(char) + sizeof(int) + sizeof(int) + sizeof(int) + (shipArr.size() * (sizeof(int) * SHIP_INTS));
+    out.resize(message_size);
+    char* message = &out[0];
 
     char message_type = 'S';
     int message_index = 0;
@@ -148,74 +209,44 @@ char * Protocol::CrunchetizeMeCapn(int clientID, std::vector<Ship*> shipArr, int
     // prepare message
     for(int i = 0; i < shipArr.size(); i++)
     {
-        // 0:   ID
-        int val = shipArr[i]->getID();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        // 1:   X pos
-        val = shipArr[i]->getXpos();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        // 2:   y pos
-        val = shipArr[i]->getYpos();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        // 3:   orientation
-        val = (int)shipArr[i]->getOrientation();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        // 4:   HP (cur)
-        val = shipArr[i]->getHullPointsCur();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-
-        // 5:   HP (tot)
-        val = shipArr[i]->getHullPointsMax();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        // 6:   TL
-        val = shipArr[i]->getTargetLock();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-       
-        // 7:   AC
-        val = shipArr[i]->getArmourClass();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-      
-        // 8:   attack bonus
-        val = (int) 0;
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
-        
-        for(int j = 0; j < 4; j++)
-        {
-            val = shipArr[i]->getShieldCur((Shield)j);
-            memcpy(&message[message_index], &val, sizeof(int));
-            message_index += sizeof(int);
-
-            val = shipArr[i]->getShieldMax((Shield)j);
-            memcpy(&message[message_index], &val, sizeof(int));
-            message_index += sizeof(int);
-        }
-
-        val = shipArr[i]->getOwner();
-        memcpy(&message[message_index], &val, sizeof(int));
-        message_index += sizeof(int);
+        int record[SHIP_INTS];
+        PackShip(shipArr[i], record);
+        memcpy(&message[message_index], record, sizeof(record));
+        message_index += sizeof(record);
     }
-    return message;
 }
 
-char* Protocol::SerializeProjectileArray(std::vector<Projectile*> projArr)
+void Protocol::SerializeProjectiles(const ProjectilePool& pool, std::string& out)
 {
-    char* message;
+    int count = pool.getCount();
+    int message_size = PROJECTILE_HEADER_SIZE + count * PROJECTILE_BYTES;
+    out.resize(message_size);
+    char* message = &out[0];
+
+    message[0] = 'P';
+    memcpy(&message[sizeof(char)], &message_size, sizeof(int));
+    memcpy(&message[sizeof(char) + sizeof(int)], &count, sizeof(int));
+
+    char* column = &message[PROJECTILE_HEADER_SIZE];
+    memcpy(column, pool.getXs(), count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(column, pool.getYs(), count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(column, pool.getRolls(), count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(column, pool.getDamages(), count * sizeof(int));
+    column += count * sizeof(int);
+    memcpy(column, pool.getOrientations(), count);
+}
+
+static_assert(ShipRecord::count == SHIP_INTS, "SHIP_INTS must match the fields in ShipRecord.h");
 
-    message = new char [1];
+void Protocol::PackShip(Ship* ship, int* record)
+{
+    ShipRecord::Pack(ship, record);
+}
 
-    return message;
+void Protocol::UnpackShip(const int* record, Ship* ship)
+{
+    ShipRecord::Unpack(record, ship);
 }
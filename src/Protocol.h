@@ -2,18 +2,62 @@
 #include <cstring>
 #include "Ship.h"
 #include "Projectile.h"
+#include "ProjectilePool.h"
+#include "RingBuffer.h"
 
 using namespace std;
 
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
+
+#define MAX_MESSAGE_SIZE (16 * 1024 * 1024) // anything claiming more is garbage
+#define SHIP_INTS (18) // ints in a ShipRecord, checked against it at compile time
+#define UDP_MAX_PAYLOAD 1200    // bigger snapshots stay on TCP rather than fragment
+#define INPUT_MESSAGE_SIZE (sizeof(char) + sizeof(int) + sizeof(char))    // 'I' sequence buttons
+#define INPUT_ACK_SIZE (sizeof(char) + 2 * sizeof(int))                     // 'K' snapshot input
+#define SHIP_HEADER_SIZE (sizeof(char) + 3 * sizeof(int))                   // 'S' length clientID count
+#define PROJECTILE_HEADER_SIZE (sizeof(char) + 2 * sizeof(int))             // 'P' length count
+#define PROJECTILE_BYTES (4 * sizeof(int) + sizeof(char))                   // one projectile across the columns
+
+// Snapshot formats, agreed with a 'V' message after the 'C' handshake. Clients
+// that never send one get WIRE_VERSION_INTS
+#define WIRE_VERSION_INTS 1     // 'D', every field a whole int
+#define WIRE_VERSION_PACKED 2   // 'Q', fields bit packed to the ranges in ShipRecord.h
+#define WIRE_VERSION_LATEST WIRE_VERSION_PACKED
+
 namespace Protocol
 {
-	int	ParseClientIDMessage(char * message, int message_size);
-    std::vector<Ship*> ParseShipMessage(int sd, char * message, int message_size, int &clientID);
-    char* CrunchetizeMeCapn(int clientID, std::vector<Ship*> shipArr, int& message_size);
-    std::vector<Projectile*> ParseProjectileMessage(char* message);
-    char* SerializeProjectileArray(std::vector<Projectile*> projArr);
+    // Total length of the message starting at header, 0 if more bytes are needed
+    // to tell, -1 if the header is not a valid message
+    int FrameLength(const char* header, int available);
+    // Next complete message in the stream, or NULL. length is set to the message
+    // size, 0 while incomplete, -1 if the stream is corrupt. Consume(length) when done
+    const char* NextMessage(RingBuffer& in, int& length);
+
+	int	ParseClientIDMessage(const char * message, int message_size);
+    std::vector<Ship*> ParseShipMessage(int sd, const char * message, int message_size, int &clientID);
+    // Fills out with an 'S' message; out is reused, so a caller sending every
+    // frame can keep one string around instead of allocating each time
+    void CrunchetizeMeCapn(int clientID, const std::vector<Ship*>& shipArr, std::string& out);
+    // 'I': the buttons held for one input (INPUT_* in Movement.h), numbered by
+    // the client. out must hold INPUT_MESSAGE_SIZE bytes
+    void PackInputMessage(int sequence, char buttons, char* out);
+    void ParseInputMessage(const char* message, int& sequence, char& buttons);
+    // 'K': snapshot snapshotSequence (and every one after it) includes the
+    // sender's inputs up to inputSequence. out must hold INPUT_ACK_SIZE bytes
+    void PackInputAck(int snapshotSequence, int inputSequence, char* out);
+    void ParseInputAck(const char* message, int& snapshotSequence, int& inputSequence);
+    // 'P': [char 'P'][int length][int count], then the pool's columns one
+    // after the other: count ints of x, of y, of roll, of damage, then count
+    // orientation bytes. out is reused like in CrunchetizeMeCapn
+    void SerializeProjectiles(const ProjectilePool& pool, std::string& out);
+    // Replaces what is in pool with the message's projectiles; false (and
+    // pool left empty) if the message is not a whole 'P'
+    bool ParseProjectileMessage(const char* message, int message_size, ProjectilePool& pool);
+
+    // One ship as the SHIP_INTS ints it occupies on the wire (see ShipRecord.h)
+    void PackShip(Ship* ship, int* record);
+    void UnpackShip(const int* record, Ship* ship);
 
 }
 #endif
\ No newline at end of file
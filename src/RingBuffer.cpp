@@ -0,0 +1,133 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "RingBuffer.h"
+
+RingBuffer::RingBuffer(int capacity)
+{
+    int cap = 64;
+    while(cap < capacity)
+        cap <<= 1;
+    data.resize(cap);
+    head = 0;
+    tail = 0;
+}
+
+unsigned int RingBuffer::mask()
+{
+    return data.size() - 1;
+}
+
+int RingBuffer::size()
+{
+    return tail - head;
+}
+
+int RingBuffer::capacity()
+{
+    return data.size();
+}
+
+int RingBuffer::freeSpace()
+{
+    return data.size() - size();
+}
+
+void RingBuffer::Reserve(int n)
+{
+    if(freeSpace() >= n)
+        return;
+
+    int used = size();
+    int cap = data.size();
+    while(cap - used < n)
+        cap <<= 1;
+
+    // Unwrap into the new storage so the unread bytes start at zero
+    std::vector<char> grown(cap);
+    Peek(&grown[0], 0, used);
+    data.swap(grown);
+    head = 0;
+    tail = used;
+}
+
+int RingBuffer::ReadFrom(int sd)
+{
+    // Never hand the kernel a zero-length buffer, that would look like EOF
+    if(freeSpace() == 0)
+        Reserve(data.size());
+
+    unsigned int start = tail & mask();
+    unsigned int space = freeSpace();
+    unsigned int first = data.size() - start;
+    if(first > space)
+        first = space;
+
+    struct iovec iov[2];
+    iov[0].iov_base = &data[start];
+    iov[0].iov_len = first;
+    iov[1].iov_base = &data[0];
+    iov[1].iov_len = space - first;
+
+    ssize_t got;
+    do
+    {
+        got = readv(sd, iov, iov[1].iov_len > 0 ? 2 : 1);
+    } while(got < 0 && errno == EINTR);
+
+    if(got > 0)
+        tail += got;
+    return got;
+}
+
+void RingBuffer::Append(const char* src, int n)
+{
+    Reserve(n);
+    unsigned int start = tail & mask();
+    unsigned int first = data.size() - start;
+    if(first > (unsigned int)n)
+        first = n;
+    memcpy(&data[start], src, first);
+    memcpy(&data[0], src + first, n - first);
+    tail += n;
+}
+
+void RingBuffer::Peek(char* dst, int offset, int n)
+{
+    unsigned int start = (head + offset) & mask();
+    unsigned int first = data.size() - start;
+    if(first > (unsigned int)n)
+        first = n;
+    memcpy(dst, &data[start], first);
+    memcpy(dst + first, &data[0], n - first);
+}
+
+const char* RingBuffer::Front(int n)
+{
+    unsigned int start = head & mask();
+    if(start + n <= data.size())
+        return &data[start];
+
+    if(scratch.size() < (unsigned int)n)
+        scratch.resize(n);
+    Peek(&scratch[0], 0, n);
+    return &scratch[0];
+}
+
+void RingBuffer::Consume(int n)
+{
+    head += n;
+    // Rewind once empty so the next read starts contiguous
+    if(head == tail)
+    {
+        head = 0;
+        tail = 0;
+    }
+}
+
+void RingBuffer::Clear()
+{
+    head = 0;
+    tail = 0;
+}
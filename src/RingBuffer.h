@@ -0,0 +1,45 @@
+#include <vector>
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+// Byte ring used to receive from a stream socket. Reads land directly in the
+// free space (both halves of it when it wraps) so one syscall can pick up as
+// many messages as the kernel has, and partial messages simply wait for the
+// next read. Capacity is always a power of two and grows on demand.
+class RingBuffer
+{
+private:
+    std::vector<char> data;
+    std::vector<char> scratch;  // linear copy of a message that wraps the end
+    unsigned int head;          // total bytes ever consumed
+    unsigned int tail;          // total bytes ever written
+
+    unsigned int mask();
+
+public:
+    RingBuffer(int capacity = 4096);
+
+    int size();
+    int capacity();
+    int freeSpace();
+
+    // Make sure at least n more bytes fit without wrapping over unread data
+    void Reserve(int n);
+
+    // One readv() into the free space. Returns bytes read, 0 on orderly
+    // shutdown, -1 on error with errno set (EAGAIN when non-blocking and dry)
+    int ReadFrom(int sd);
+    void Append(const char* src, int n);
+
+    // Copy n bytes starting offset bytes in, without consuming them
+    void Peek(char* dst, int offset, int n);
+
+    // Pointer to the first n unread bytes as one contiguous block. Valid until
+    // the next call that changes the buffer
+    const char* Front(int n);
+    void Consume(int n);
+    void Clear();
+};
+
+#endif
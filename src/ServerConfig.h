@@ -0,0 +1,34 @@
+#ifndef SERVERCONFIG_H
+#define SERVERCONFIG_H
+
+// Server-wide settings from the command line. Every worker and session keeps
+// its own copy, so they are read without locking
+struct ServerConfig
+{
+    // Fixed tick mode: updates are applied as they arrive but only broadcast
+    // once per tick, as one snapshot. 0 = broadcast after every update
+    int tickHz = 0;
+    int numWorkers = 1;
+    bool interest = true;       // only send ships within the viewer's sensor range
+
+    // Slow consumers: past slowClientBytes queued, a client is skipped by
+    // broadcasts until it drains (it catches up from its last ack, so nothing
+    // is lost). Past maxQueuedBytes, or maxSkippedSnapshots skips in a row,
+    // it is disconnected
+    long slowClientBytes = 64 * 1024;
+    long maxQueuedBytes = 1024 * 1024;
+    int maxSkippedSnapshots = 200;
+
+    // Snapshots over UDP for clients that ask for it ('U'); everything else
+    // stays on TCP. udpDropPercent throws away that share of outgoing
+    // datagrams, to try packet loss on loopback
+    bool udp = false;
+    int udpDropPercent = 0;
+
+    // Metrics page on 127.0.0.1, 0 = off. Per-client series are one line per
+    // client per metric, so they are opt-in
+    int metricsPort = 9081;
+    bool metricsPerClient = false;
+};
+
+#endif
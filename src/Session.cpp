@@ -0,0 +1,377 @@
+#include <iostream>
+#include <memory>
+#include <map>
+#include <tuple>
+#include <string>
+#include <string.h>
+#include "Protocol.h"
+#include "Snapshot.h"
+#include "Movement.h"
+#include "Worker.h"
+#include "Session.h"
+
+using namespace std;
+
+Session::Session(int sid, Worker* w, const ServerConfig& cfg)
+{
+    id = sid;
+    worker = w;
+    config = cfg;
+    nextShipID = 0;
+    snapshotSequence = 0;
+    shipsDirty = false;
+}
+
+Session::~Session()
+{
+    for(int i = 0; i < masterShipList.size(); i++)
+        delete masterShipList[i];
+}
+
+int Session::getID()
+{
+    return id;
+}
+
+Worker* Session::getWorker()
+{
+    return worker;
+}
+
+int Session::getClientCount()
+{
+    return clients.size();
+}
+
+int Session::getShipCount()
+{
+    return masterShipList.size();
+}
+
+void Session::Join(Connection* conn)
+{
+    // The master list is indexed by ID, so reuse freed IDs to keep it short
+    int cid = nextShipID;
+    if(!freeIDs.empty())
+    {
+        cid = *freeIDs.begin();
+        freeIDs.erase(freeIDs.begin());
+    }
+    else
+        nextShipID++;
+    conn->setClientID(cid);
+    clients[conn->getSocket()] = conn;
+
+    // Send connection its clientID (TODO probably security stuff too, can send encryption or something)
+    char client_id_msg[sizeof(char) + sizeof(int)];
+    char msgType = 'C';
+    memcpy(&client_id_msg[0], &msgType, sizeof(char));
+    memcpy(&client_id_msg[sizeof(char)], &cid, sizeof(int));
+    if(!conn->Send(client_id_msg, sizeof(client_id_msg)))
+        worker->CloseLater(conn);
+
+    cerr << "Session " << id << ": client " << cid << " joined, " << clients.size() << " clients. " << masterShipList.size() << "\n";
+}
+
+// Takes the leaver's own ship off the board (an empty slot until its ID is
+// handed out again) and frees the ID
+void Session::Leave(Connection* conn)
+{
+    clients.erase(conn->getSocket());
+    int cid = conn->getClientID();
+    if(cid < 0)
+        return;
+    freeIDs.insert(cid);
+    vector<Ship*> &ml = masterShipList;
+    if(cid < (int)ml.size())
+    {
+        delete ml[cid];
+        ml[cid] = new Ship();
+    }
+    while(!ml.empty() && ml.back()->getID() < 0)
+    {
+        delete ml.back();
+        ml.pop_back();
+    }
+    shipsDirty = true;
+}
+
+void Session::HandleMessage(Connection* conn, const char* buffer, int length)
+{
+    int fromClient;
+    char msgType = 'Z';
+    memcpy(&msgType, &buffer[0], sizeof(char));
+    if(msgType == '0')
+    {
+        memcpy(&fromClient, &buffer[sizeof(char)], sizeof(int));
+        // acknowledge with the same framed message so the client reader stays in sync
+        char msg[sizeof(char) + sizeof(int)];
+        memcpy(&msg[0], &msgType, sizeof(char));
+        memcpy(&msg[sizeof(char)], &fromClient, sizeof(int));
+        if(!conn->Send(msg, sizeof(msg)))
+            worker->CloseLater(conn);
+        cerr << "Session " << id << ": quit request from client " << fromClient << "\n";
+    }
+    else if(msgType == 'U')
+    {
+        // Wants snapshots by UDP: tell it where to say hello and with what.
+        // Port 0 means UDP is off and everything stays on this stream
+        int token = worker->OpenUdp(conn);
+        int port = token < 0 ? 0 : worker->getUdpPort();
+        char msg[sizeof(char) + 2 * sizeof(int)];
+        memcpy(&msg[0], &msgType, sizeof(char));
+        memcpy(&msg[sizeof(char)], &port, sizeof(int));
+        memcpy(&msg[sizeof(char) + sizeof(int)], &token, sizeof(int));
+        if(!conn->Send(msg, sizeof(msg)))
+            worker->CloseLater(conn);
+    }
+    else if(msgType == 'V')
+    {
+        // Snapshot format the client can read: settle on the newest both
+        // sides know and say which. Baselines carry over, so this can come
+        // at any time, but clients send it right behind the 'C'
+        int version;
+        memcpy(&version, &buffer[sizeof(char)], sizeof(int));
+        version = version > WIRE_VERSION_LATEST ? WIRE_VERSION_LATEST : version;
+        if(version < WIRE_VERSION_INTS)
+            version = WIRE_VERSION_INTS;
+        conn->setWireVersion(version);
+        char msg[sizeof(char) + sizeof(int)];
+        memcpy(&msg[0], &msgType, sizeof(char));
+        memcpy(&msg[sizeof(char)], &version, sizeof(int));
+        if(!conn->Send(msg, sizeof(msg)))
+            worker->CloseLater(conn);
+    }
+    else if(msgType == 'A')
+    {
+        int sequence;
+        memcpy(&sequence, &buffer[sizeof(char)], sizeof(int));
+        conn->Acknowledge(sequence);
+    }
+    else if(msgType == 'I')
+    {
+        // The client only says which buttons it held; where that takes its
+        // ship is worked out here, by the same rules the client predicts with
+        int sequence;
+        char buttons;
+        Protocol::ParseInputMessage(buffer, sequence, buttons);
+        // Handled even if there is no ship to move yet, so the client stops predicting it
+        conn->setInputSequence(sequence);
+        Ship* own = OwnShip(conn->getClientID());
+        if(own == NULL)
+            return;
+        Movement::Apply(own, buttons, BOARD_COLS, BOARD_ROWS);
+        if(config.tickHz > 0)
+            shipsDirty = true;
+        else
+            BroadcastSnapshot();
+    }
+    else if(msgType == 'P')
+    {
+        // Weapons fire goes out to everyone else in the session just as it
+        // came in, once it is known to be a proper 'P'. One buffer for all.
+        // Slow clients are treated as for snapshots: skipped while behind,
+        // dropped once their queue is past the limit
+        if(!Protocol::ParseProjectileMessage(buffer, length, projectiles))
+            return;
+        WorkerMetrics& metrics = worker->getMetrics();
+        SharedBuffer burst(new string(buffer, length));
+        for(auto it = clients.begin(); it != clients.end(); ++it)
+        {
+            Connection* client = it->second;
+            if(client == conn || client->isClosing())
+                continue;
+            if(client->getPendingBytes() > config.slowClientBytes)
+            {
+                metrics.projectilesSkipped.Add();
+                continue;
+            }
+            if(!client->Send(burst))
+                worker->CloseLater(client);
+            else if(client->getPendingBytes() > config.maxQueuedBytes)
+            {
+                cerr << "Session " << id << ": client " << client->getClientID() << " is " << client->getPendingBytes() << " bytes behind, dropping it\n";
+                metrics.slowDrops.Add();
+                worker->CloseLater(client);
+            }
+            else
+            {
+                client->CountProjectiles(length);
+                metrics.projectileSends.Add();
+            }
+        }
+    }
+    else if(msgType == 'S')
+    {
+        // The ID handed out at join is authoritative, whatever the message claims
+        std::vector<Ship*> clientShips;
+        {
+            ScopedTimer timer(worker->getMetrics().parseUs);
+            clientShips = Protocol::ParseShipMessage(conn->getSocket(), buffer, length, fromClient);
+        }
+        UpdateMasterList(clientShips, conn->getClientID());
+        if(config.tickHz > 0)
+            shipsDirty = true;
+        else
+            BroadcastSnapshot();
+    }
+}
+
+int Session::Tick()
+{
+    if(!shipsDirty)
+        return 0;
+    shipsDirty = false;
+    return BroadcastSnapshot();
+}
+
+// Sends every client only what changed since the last snapshot it acknowledged,
+// limited to the ships within its own ship's sensor range (clients without a
+// ship yet see everything). Clients that can see the same ships share one
+// snapshot and clients acknowledging the same baseline in the same wire format
+// share one encoded buffer, queued by reference, so with everyone caught up this is one encode
+// per distinct view. Clients still sitting on a backlog are skipped
+int Session::BroadcastSnapshot()
+{
+    WorkerMetrics& metrics = worker->getMetrics();
+    ScopedTimer timer(metrics.broadcastUs);
+    metrics.snapshots.Add();
+    int seq = ++snapshotSequence;
+    shared_ptr<const Snapshot> everything;
+    map<vector<int>, shared_ptr<const Snapshot> > views;
+    map<tuple<const Snapshot*, const Snapshot*, int>, SharedBuffer> encoded;
+    int sends = 0;
+
+    if(config.interest)
+        interest.Rebuild(masterShipList);
+    // Acks by UDP can sit behind a busy TCP stream; take them now so
+    // baselines are as fresh as they can be
+    if(config.udp)
+        worker->ReadDatagrams();
+
+    for(auto it = clients.begin(); it != clients.end(); ++it)
+    {
+        Connection* client = it->second;
+        if(client->isClosing())
+            continue;
+        if(client->getPendingBytes() > config.slowClientBytes)
+        {
+            metrics.snapshotsSkipped.Add();
+            if(client->SkipSnapshot() > config.maxSkippedSnapshots)
+            {
+                cerr << "Session " << id << ": client " << client->getClientID() << " stopped reading, dropping it\n";
+                metrics.slowDrops.Add();
+                worker->CloseLater(client);
+            }
+            continue;
+        }
+
+        int cid = client->getClientID();
+        Ship* own = cid >= 0 && cid < (int)masterShipList.size() ? masterShipList[cid] : NULL;
+        shared_ptr<const Snapshot> current;
+        if(!config.interest || own == NULL || own->getID() < 0)
+        {
+            if(!everything)
+                everything = make_shared<Snapshot>(seq, masterShipList);
+            current = everything;
+        }
+        else
+        {
+            interest.Query(own->getXpos(), own->getYpos(), own->getSensorRange(), visible);
+            shared_ptr<const Snapshot>& view = views[visible];
+            if(!view)
+                view = make_shared<Snapshot>(seq, masterShipList, visible);
+            current = view;
+        }
+
+        const Snapshot* base = client->getBaseline();
+        auto key = make_tuple(base, current.get(), client->getWireVersion());
+        auto enc = encoded.find(key);
+        if(enc == encoded.end())
+        {
+            string* message = new string();
+            ScopedTimer encodeTimer(metrics.encodeUs);
+            if(client->getWireVersion() == WIRE_VERSION_PACKED)
+                current->EncodePacked(base, *message);
+            else
+                current->EncodeDelta(base, *message);
+            enc = encoded.insert(make_pair(key, SharedBuffer(message))).first;
+        }
+
+        // Snapshots are latest-wins, so by UDP when the client has one, unless
+        // the datagram would have to be fragmented. New input acks go first,
+        // always by TCP: they must not get lost, and a client that finds its
+        // snapshot came in ahead of the ack just predicts from the older one.
+        // An ack followed by a TCP snapshot goes out in the same write, so
+        // the snapshot is not held back waiting on the ack's ACK
+        {
+            ScopedTimer sendTimer(metrics.sendUs);
+            bool udp = client->isUdpBound() && enc->second->size() <= UDP_MAX_PAYLOAD;
+            if(client->getInputSequence() != client->getReportedInput())
+            {
+                char ack[INPUT_ACK_SIZE];
+                Protocol::PackInputAck(seq, client->getInputSequence(), ack);
+                client->setReportedInput(client->getInputSequence());
+                if(!client->Send(ack, sizeof(ack), !udp))
+                    worker->CloseLater(client);
+            }
+            if(udp)
+                worker->SendDatagram(client, enc->second);
+            else if(!client->Send(enc->second))
+                worker->CloseLater(client);
+            else if(client->getPendingBytes() > config.maxQueuedBytes)
+            {
+                cerr << "Session " << id << ": client " << cid << " is " << client->getPendingBytes() << " bytes behind, dropping it\n";
+                metrics.slowDrops.Add();
+                worker->CloseLater(client);
+            }
+        }
+        client->RememberSnapshot(current);
+        metrics.snapshotSends.Add();
+        sends++;
+    }
+    return sends;
+}
+
+// The client's ship, once its first 'S' has put one in the master list
+Ship* Session::OwnShip(int cid)
+{
+    if(cid < 0 || cid >= (int)masterShipList.size() || masterShipList[cid]->getID() != cid)
+        return NULL;
+    return masterShipList[cid];
+}
+
+// cl - client list by reference
+// cid- client id
+void Session::UpdateMasterList(vector<Ship*> &cl, int cid)
+{
+    vector<Ship*> &ml = masterShipList;
+    // verify client (TODO) - for now, probably can be as simple as making sure no client tried to change a ship.id
+    // Clients only hold the ships they can see, so find the sender's ship by ID.
+    // Older clients keep the whole list in master list order, with theirs at cid
+    int own = -1;
+    for(int i = 0; i < cl.size() && own < 0; i++)
+    {
+        if(cl[i]->getID() == cid)
+            own = i;
+    }
+    if(own < 0 && cid >= 0 && cid < (int)cl.size())
+        own = cid;
+    if(cid < 0 || own < 0)
+    {
+        for(int i = 0; i < cl.size(); i++)
+            delete cl[i];
+        return;
+    }
+    while(ml.size() < cid+1)
+        ml.push_back(new Ship());
+    delete ml[cid];
+    ml[cid] = cl[own];
+    ml[cid]->setID(cid);
+    // only the sender's own ship is taken, the rest of its list is stale
+    for(int i = 0; i < cl.size(); i++)
+    {
+        if(i != own)
+            delete cl[i];
+    }
+}
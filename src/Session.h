@@ -0,0 +1,58 @@
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include "Ship.h"
+#include "Connection.h"
+#include "ServerConfig.h"
+#include "InterestGrid.h"
+#include "ProjectilePool.h"
+
+#ifndef SESSION_H
+#define SESSION_H
+
+class Worker;
+
+// One battle: its own master ship list, its own clients and its own tick.
+// A session lives on exactly one Worker and is only ever touched from that
+// worker's thread, so nothing in here needs locking.
+class Session
+{
+private:
+    int id;
+    Worker* worker;
+    ServerConfig config;
+
+    std::vector<Ship*> masterShipList;
+    std::unordered_map<int, Connection*> clients;   // keyed by socket
+    int nextShipID;             // first ID never handed out
+    std::set<int> freeIDs;      // IDs of clients that left, reused lowest first
+    int snapshotSequence;       // sequence number of the last snapshot broadcast
+    bool shipsDirty;            // something changed since the last tick
+    InterestGrid interest;      // master list bucketed by position, rebuilt per broadcast
+    std::vector<int> visible;   // scratch for interest queries
+    ProjectilePool projectiles; // scratch for checking 'P' bursts
+
+    void UpdateMasterList(std::vector<Ship*> &cl, int cid);
+    Ship* OwnShip(int cid);
+    int BroadcastSnapshot();
+
+public:
+    Session(int id, Worker* w, const ServerConfig& config);
+    ~Session();
+
+    int getID();
+    Worker* getWorker();
+    int getClientCount();
+    int getShipCount();
+
+    // Hands the client its ID ('C' reply) and starts including it in broadcasts
+    void Join(Connection* conn);
+    void Leave(Connection* conn);
+
+    void HandleMessage(Connection* conn, const char* buffer, int length);
+
+    // Broadcasts once if anything changed; returns the number of sends made
+    int Tick();
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include <iostream>
+#include "SessionManager.h"
+
+using namespace std;
+
+SessionManager::SessionManager(const ServerConfig& cfg)
+{
+    config = cfg;
+    int numWorkers = config.numWorkers < 1 ? 1 : config.numWorkers;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(new Worker(i, config));
+        sessionsPerWorker.push_back(0);
+    }
+}
+
+SessionManager::~SessionManager()
+{
+    // Workers own the sessions they run
+    for(int i = 0; i < workers.size(); i++)
+        delete workers[i];
+}
+
+void SessionManager::Start()
+{
+    for(int i = 0; i < workers.size(); i++)
+        workers[i]->Start();
+}
+
+void SessionManager::Assign(Connection* conn, int sessionID)
+{
+    Session* session;
+    auto it = sessions.find(sessionID);
+    if(it != sessions.end())
+        session = it->second;
+    else
+    {
+        int least = 0;
+        for(int i = 1; i < workers.size(); i++)
+        {
+            if(sessionsPerWorker[i] < sessionsPerWorker[least])
+                least = i;
+        }
+        session = new Session(sessionID, workers[least], config);
+        sessions[sessionID] = session;
+        sessionsPerWorker[least]++;
+        cerr << "Session " << sessionID << " started on worker " << least << "\n";
+    }
+    session->getWorker()->Adopt(conn, session);
+}
+
+int SessionManager::getSessionCount()
+{
+    return sessions.size();
+}
+
+int SessionManager::getWorkerCount()
+{
+    return workers.size();
+}
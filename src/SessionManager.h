@@ -0,0 +1,35 @@
+#include <vector>
+#include <unordered_map>
+#include "Connection.h"
+#include "Session.h"
+#include "Worker.h"
+#include "ServerConfig.h"
+
+#ifndef SESSIONMANAGER_H
+#define SESSIONMANAGER_H
+
+// Owns the worker threads and decides which one runs each battle. Sessions
+// are created the first time a client asks for them and go to the worker
+// running the fewest sessions. Only the accepting thread calls in here.
+class SessionManager
+{
+private:
+    ServerConfig config;
+    std::vector<Worker*> workers;
+    std::vector<int> sessionsPerWorker;
+    std::unordered_map<int, Session*> sessions;
+
+public:
+    SessionManager(const ServerConfig& config);
+    ~SessionManager();
+
+    void Start();
+
+    // Moves a handshaken connection into the session it asked for
+    void Assign(Connection* conn, int sessionID);
+
+    int getSessionCount();
+    int getWorkerCount();
+};
+
+#endif
@@ -7,6 +7,8 @@ using std::to_string;
     id = -1;
     x_pos = 0;
     y_pos = 0;
+    sensorRange = DEFAULT_SENSOR_RANGE;
+    attackBonus = 0;    // sent on the wire
 }
 
         Ship::Ship(int sid, int sp, Maneuverability m, int ac, int tl, int dm, int crit, int pcc, int hp, int * shield)
@@ -15,6 +17,7 @@ using std::to_string;
 
     x_pos = 0;
     y_pos = 0;
+    sensorRange = DEFAULT_SENSOR_RANGE;
 
     attackBonus = 0;
     speed = sp;
@@ -37,9 +40,12 @@ using std::to_string;
 
         Ship::Ship(const Ship& cpy)
 {
+    id = cpy.id;
+    ownerCID = cpy.ownerCID;
     this->setXpos(cpy.getXpos());
     this->setYpos(cpy.getYpos());
     this->setOrientation(cpy.getOrientation());
+    this->setSensorRange(cpy.getSensorRange());
 }
 
     Ship::~Ship()
@@ -294,6 +300,15 @@ void        Ship::setOrientation(Orientation o)
     orientation = o;
 }
 
+int Ship::getSensorRange() const
+{
+    return sensorRange;
+}
+void Ship::setSensorRange(int r)
+{
+    sensorRange = r;
+}
+
 int         Ship::getShieldMax(Shield sh)
 {
     return shieldTot[sh];
@@ -357,6 +372,7 @@ Ship& Ship::operator=(const Ship &ship)
 {
     x_pos = ship.x_pos;
     y_pos = ship.y_pos;
+    sensorRange = ship.sensorRange;
     targetLock = ship.targetLock;
     armourClass = ship.armourClass;
     hullPointsMax = ship.hullPointsMax;
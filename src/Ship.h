@@ -7,6 +7,8 @@ using std::string;
 #ifndef SHIP_H
 #define SHIP_H
 
+#define DEFAULT_SENSOR_RANGE 20 // hexes a ship can see, for server-side interest filtering
+
 enum Maneuverability {
 	CLUMSY,
 	POOR,
@@ -97,6 +99,8 @@ private:
 
     Orientation orientation;
 
+    int sensorRange;            // hexes; other ships further away are not sent to this ship's client
+
 public:
 
 	Ship();
@@ -181,6 +185,9 @@ public:
     Orientation getOrientation() const;
     void setOrientation(Orientation);
 
+    int getSensorRange() const;
+    void setSensorRange(int);
+
     int getShieldCur(Shield);
     void setShieldCur(Shield, int);
 
@@ -0,0 +1,153 @@
+#include "Ship.h"
+
+#ifndef SHIPRECORD_H
+#define SHIPRECORD_H
+
+// The ship record sent on the wire ('S', 'D', 'Q') is described once, here:
+// one small struct per int in the record, in wire order, saying how to get
+// it out of a Ship, how to put it back, and the range it packs to in 'Q'
+// (values from min to min + 2^bits - 2 take bits bits, anything else is
+// escaped as bits ones followed by the whole int).
+// ShipRecord expands the list into straight-line code at compile time, so
+// the encoder and decoder cannot drift apart the way hand-written copies did.
+namespace ShipFields
+{
+    struct ID
+    {
+        static const int min = 0, bits = 0;    // sent separately in 'Q'
+        static int Get(Ship* s) { return s->getID(); }
+        static void Set(Ship* s, int v) { s->setID(v); }
+    };
+
+    // The board is 100 across
+    struct X
+    {
+        static const int min = 0, bits = 7;
+        static int Get(Ship* s) { return s->getXpos(); }
+        static void Set(Ship* s, int v) { s->setXpos(v); }
+    };
+
+    struct Y
+    {
+        static const int min = 0, bits = 7;
+        static int Get(Ship* s) { return s->getYpos(); }
+        static void Set(Ship* s, int v) { s->setYpos(v); }
+    };
+
+    struct Facing
+    {
+        static const int min = 0, bits = 3;
+        static int Get(Ship* s) { return (int)s->getOrientation(); }
+        static void Set(Ship* s, int v) { s->setOrientation((Orientation)v); }
+    };
+
+    struct HullPoints
+    {
+        static const int min = 0, bits = 8;
+        static int Get(Ship* s) { return s->getHullPointsCur(); }
+        static void Set(Ship* s, int v) { s->setHullPointsCur(v); }
+    };
+
+    struct HullPointsMax
+    {
+        static const int min = 0, bits = 8;
+        static int Get(Ship* s) { return s->getHullPointsMax(); }
+        static void Set(Ship* s, int v) { s->setHullPointsMax(v); }
+    };
+
+    struct TargetLock
+    {
+        static const int min = 0, bits = 6;
+        static int Get(Ship* s) { return s->getTargetLock(); }
+        static void Set(Ship* s, int v) { s->setTargetLock(v); }
+    };
+
+    struct ArmourClass
+    {
+        static const int min = 0, bits = 6;
+        static int Get(Ship* s) { return s->getArmourClass(); }
+        static void Set(Ship* s, int v) { s->setArmourClass(v); }
+    };
+
+    struct AttackBonus
+    {
+        static const int min = 0, bits = 4;
+        static int Get(Ship* s) { return s->getAttackBonus(); }
+        static void Set(Ship* s, int v) { s->setAttackBonus(v); }
+    };
+
+    template<Shield side>
+    struct ShieldCur
+    {
+        static const int min = 0, bits = 8;
+        static int Get(Ship* s) { return s->getShieldCur(side); }
+        static void Set(Ship* s, int v) { s->setShieldCur(side, v); }
+    };
+
+    template<Shield side>
+    struct ShieldMax
+    {
+        static const int min = 0, bits = 8;
+        static int Get(Ship* s) { return s->getShieldMax(side); }
+        static void Set(Ship* s, int v) { s->setShieldMax(side, v); }
+    };
+
+    // -1 for ships nobody has claimed
+    struct Owner
+    {
+        static const int min = -1, bits = 12;
+        static int Get(Ship* s) { return s->getOwner(); }
+        static void Set(Ship* s, int v) { s->setOwner(v); }
+    };
+}
+
+struct PackedRange
+{
+    int min;
+    int bits;
+};
+
+template<class... Fields>
+struct FieldList
+{
+    static const int count = sizeof...(Fields);
+    static const PackedRange ranges[sizeof...(Fields)];
+
+    // Braced lists are evaluated left to right, so these run field by field
+    // in wire order with no loop or call left once inlined
+    static void Pack(Ship* ship, int* record)
+    {
+        int i = 0;
+        int unused[] = {(record[i++] = Fields::Get(ship))...};
+        (void)unused;
+    }
+
+    static void Unpack(const int* record, Ship* ship)
+    {
+        int i = 0;
+        int unused[] = {(Fields::Set(ship, record[i++]), 0)...};
+        (void)unused;
+    }
+};
+
+template<class... Fields>
+const PackedRange FieldList<Fields...>::ranges[sizeof...(Fields)] = {{Fields::min, Fields::bits}...};
+
+typedef FieldList<
+    ShipFields::ID,
+    ShipFields::X,
+    ShipFields::Y,
+    ShipFields::Facing,
+    ShipFields::HullPoints,
+    ShipFields::HullPointsMax,
+    ShipFields::TargetLock,
+    ShipFields::ArmourClass,
+    ShipFields::AttackBonus,
+    ShipFields::ShieldCur<Fore>, ShipFields::ShieldMax<Fore>,
+    ShipFields::ShieldCur<Aft>, ShipFields::ShieldMax<Aft>,
+    ShipFields::ShieldCur<Port>, ShipFields::ShieldMax<Port>,
+    ShipFields::ShieldCur<Starboard>, ShipFields::ShieldMax<Starboard>,
+    ShipFields::Owner
+> ShipRecord;
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "Protocol.h"
+#include "ShipRecord.h"
+#include "ShipView.h"
+
+ShipView::ShipView(const char* r)
+{
+    record = r;
+}
+
+int ShipView::getField(int f) const
+{
+    int val;
+    memcpy(&val, &record[f * sizeof(int)], sizeof(int));
+    return val;
+}
+
+int ShipView::getID() const
+{
+    return getField(0);
+}
+
+int ShipView::getXpos() const
+{
+    return getField(1);
+}
+
+int ShipView::getYpos() const
+{
+    return getField(2);
+}
+
+Orientation ShipView::getOrientation() const
+{
+    return (Orientation)getField(3);
+}
+
+int ShipView::getOwner() const
+{
+    return getField(17);
+}
+
+void ShipView::CopyTo(Ship* ship) const
+{
+    int fields[SHIP_INTS];
+    memcpy(fields, record, sizeof(fields));
+    ShipRecord::Unpack(fields, ship);
+}
+
+SnapshotView::SnapshotView()
+{
+    records = NULL;
+    count = 0;
+    clientID = -1;
+}
+
+SnapshotView::SnapshotView(const Snapshot& snapshot)
+{
+    count = snapshot.getShipCount();
+    records = count > 0 ? (const char*)snapshot.getRecord(0) : NULL;
+    clientID = -1;
+}
+
+bool SnapshotView::Parse(const char* message, int message_size)
+{
+    int index = SHIP_HEADER_SIZE;
+    if(message_size < index || message[0] != 'S')
+        return false;
+    memcpy(&clientID, &message[sizeof(char) + sizeof(int)], sizeof(int));
+    memcpy(&count, &message[sizeof(char) + 2 * sizeof(int)], sizeof(int));
+
+    int fits = (message_size - index) / (int)(sizeof(int) * SHIP_INTS);
+    if(count < 0)
+        count = 0;
+    if(count > fits)
+        count = fits;
+    records = &message[index];
+    return true;
+}
+
+int SnapshotView::getClientID() const
+{
+    return clientID;
+}
+
+int SnapshotView::getShipCount() const
+{
+    return count;
+}
+
+ShipView SnapshotView::getShip(int i) const
+{
+    return ShipView(&records[i * SHIP_INTS * sizeof(int)]);
+}
+
+void ShipUpdater::Apply(const SnapshotView& view, std::vector<Ship*>& ships)
+{
+    // Index what we have by ID. Ships that can't be (no ID, an ID too big to
+    // be real, or a repeat) are dropped and made again if still wanted
+    int highest = -1;
+    for(int i = 0; i < ships.size(); i++)
+    {
+        int id = ships[i]->getID();
+        if(id < 0 || id >= SHIP_ID_LIMIT || (id < (int)byID.size() && byID[id] != NULL))
+        {
+            delete ships[i];
+            continue;
+        }
+        if(id >= (int)byID.size())
+            byID.resize(id + 1, NULL);
+        byID[id] = ships[i];
+        if(id > highest)
+            highest = id;
+    }
+
+    int count = view.getShipCount();
+    ships.resize(count);
+    for(int i = 0; i < count; i++)
+    {
+        ShipView record = view.getShip(i);
+        int id = record.getID();
+        Ship* ship;
+        if(id >= 0 && id <= highest && byID[id] != NULL)
+        {
+            ship = byID[id];
+            byID[id] = NULL;
+        }
+        else
+            ship = new Ship();
+        record.CopyTo(ship);
+        ships[i] = ship;
+    }
+
+    // Whatever was not claimed has left
+    for(int id = 0; id <= highest; id++)
+    {
+        if(byID[id] != NULL)
+        {
+            delete byID[id];
+            byID[id] = NULL;
+        }
+    }
+}
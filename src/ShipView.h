@@ -0,0 +1,67 @@
+#include <vector>
+#include "Ship.h"
+#include "Snapshot.h"
+
+#ifndef SHIPVIEW_H
+#define SHIPVIEW_H
+
+#define SHIP_ID_LIMIT 65536 // IDs past this are not tracked by ShipUpdater, just replaced
+
+// One ship record read where it lies, in a received message or a Snapshot,
+// without building a Ship. The record needn't be aligned
+class ShipView
+{
+private:
+    const char* record;     // SHIP_INTS ints
+
+public:
+    ShipView(const char* record);
+
+    int getField(int f) const;
+    int getID() const;
+    int getXpos() const;
+    int getYpos() const;
+    Orientation getOrientation() const;
+    int getOwner() const;
+
+    // Sets every field the record carries
+    void CopyTo(Ship* ship) const;
+};
+
+// The ship records of an 'S' message or a decoded Snapshot, in place. Only
+// valid while the message or snapshot is
+class SnapshotView
+{
+private:
+    const char* records;
+    int count;
+    int clientID;
+
+public:
+    SnapshotView();
+    SnapshotView(const Snapshot& snapshot);
+
+    // False if message is not an 'S'. Like ParseShipMessage, the ship count
+    // is cut down to the records that actually arrived
+    bool Parse(const char* message, int message_size);
+
+    int getClientID() const;     // the sender of an 'S', -1 for a Snapshot
+    int getShipCount() const;
+    ShipView getShip(int i) const;
+};
+
+// Keeps a ship list in step with incoming snapshots without rebuilding it.
+// The Ship already holding an ID is patched in place, so pointers to it stay
+// good, and only ships that come or go are created or deleted: with the same
+// ships in view, applying a snapshot allocates nothing
+class ShipUpdater
+{
+private:
+    std::vector<Ship*> byID;    // scratch, all NULL between calls
+
+public:
+    // ships ends up in the view's order
+    void Apply(const SnapshotView& view, std::vector<Ship*>& ships);
+};
+
+#endif
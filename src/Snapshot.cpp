@@ -0,0 +1,528 @@
+#include <string.h>
+#include <algorithm>
+#include "Protocol.h"
+#include "BitPack.h"
+#include "ShipRecord.h"
+#include "Snapshot.h"
+
+#define DELTA_HEADER_INTS 6 // length, sequence, base, ship count, removed count, changed count
+#define PACKED_HOT_FIELDS 4 // x, y and orientation get their own mask bits in 'Q', the rest share one
+#define PACKED_COLD_BITS (SHIP_INTS - PACKED_HOT_FIELDS)
+
+static void AppendInt(std::string& out, int val)
+{
+    out.append((const char*)&val, sizeof(int));
+}
+
+static int ReadInt(const char* message, int& index)
+{
+    int val;
+    memcpy(&val, &message[index], sizeof(int));
+    index += sizeof(int);
+    return val;
+}
+
+static bool ByID(const std::pair<int, Ship*>& a, const std::pair<int, Ship*>& b)
+{
+    return a.first < b.first;
+}
+
+Snapshot::Snapshot()
+{
+    sequence = -1;
+}
+
+Snapshot::Snapshot(int seq, std::vector<Ship*>& ships)
+{
+    sequence = seq;
+    Pack(ships, NULL);
+}
+
+Snapshot::Snapshot(int seq, std::vector<Ship*>& ships, const std::vector<int>& indices)
+{
+    sequence = seq;
+    Pack(ships, &indices);
+}
+
+// Packs the chosen ships in ID order, skipping ships without an ID and repeats
+void Snapshot::Pack(std::vector<Ship*>& ships, const std::vector<int>* indices)
+{
+    int count = indices ? indices->size() : ships.size();
+    std::vector<std::pair<int, Ship*> > byID;
+    byID.reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        Ship* ship = ships[indices ? (*indices)[i] : i];
+        if(ship->getID() >= 0)
+            byID.push_back(std::make_pair(ship->getID(), ship));
+    }
+    std::stable_sort(byID.begin(), byID.end(), ByID);
+
+    records.resize(byID.size() * SHIP_INTS);
+    int packed = 0;
+    for(int i = 0; i < byID.size(); i++)
+    {
+        if(i > 0 && byID[i].first == byID[i - 1].first)
+            continue;
+        Protocol::PackShip(byID[i].second, &records[packed * SHIP_INTS]);
+        packed++;
+    }
+    records.resize(packed * SHIP_INTS);
+}
+
+int Snapshot::getSequence() const
+{
+    return sequence;
+}
+
+void Snapshot::setSequence(int seq)
+{
+    sequence = seq;
+}
+
+int Snapshot::getShipCount() const
+{
+    return records.size() / SHIP_INTS;
+}
+
+const int* Snapshot::getRecord(int i) const
+{
+    return &records[i * SHIP_INTS];
+}
+
+void Snapshot::ToShips(std::vector<Ship*>& ships) const
+{
+    for(int i = 0; i < getShipCount(); i++)
+    {
+        Ship* ship = new Ship();
+        Protocol::UnpackShip(getRecord(i), ship);
+        ships.push_back(ship);
+    }
+}
+
+// Both lists are sorted by ID, so one walk finds the ships that left,
+// calling removed(id), and another the ships that changed or are new to this
+// client, calling changed(record, base record or NULL)
+template<class Removed, class Changed>
+static void Diff(const Snapshot& now, const Snapshot* base, Removed removed, Changed changed)
+{
+    int baseShips = base ? base->getShipCount() : 0;
+    int ships = now.getShipCount();
+
+    for(int b = 0, i = 0; b < baseShips; b++)
+    {
+        int id = base->getRecord(b)[0];
+        while(i < ships && now.getRecord(i)[0] < id)
+            i++;
+        if(i == ships || now.getRecord(i)[0] != id)
+            removed(id);
+    }
+
+    for(int i = 0, b = 0; i < ships; i++)
+    {
+        const int* rec = now.getRecord(i);
+        while(b < baseShips && base->getRecord(b)[0] < rec[0])
+            b++;
+        if(b < baseShips && base->getRecord(b)[0] == rec[0])
+        {
+            const int* then = base->getRecord(b);
+            if(memcmp(rec, then, SHIP_INTS * sizeof(int)) != 0)
+                changed(rec, then);
+        }
+        else
+            changed(rec, (const int*)NULL);
+    }
+}
+
+static void WritePackedField(BitWriter& bits, int f, int val)
+{
+    const PackedRange& field = ShipRecord::ranges[f];
+    unsigned int escape = (1u << field.bits) - 1;
+    unsigned int offset = (unsigned int)val - (unsigned int)field.min;
+    if(val >= field.min && offset < escape)
+        bits.Write(offset, field.bits);
+    else
+    {
+        bits.Write(escape, field.bits);
+        bits.Write((uint32_t)val, 32);
+    }
+}
+
+static int ReadPackedField(BitReader& bits, int f)
+{
+    const PackedRange& field = ShipRecord::ranges[f];
+    unsigned int escape = (1u << field.bits) - 1;
+    unsigned int offset = bits.Read(field.bits);
+    if(offset == escape)
+        return (int)bits.Read(32);
+    return (int)(offset + (unsigned int)field.min);
+}
+
+void Snapshot::EncodeDelta(const Snapshot* base, std::string& out) const
+{
+    size_t start = out.size();
+
+    out.push_back('D');
+    AppendInt(out, 0); // length, patched below
+    AppendInt(out, sequence);
+    AppendInt(out, base ? base->getSequence() : -1);
+    AppendInt(out, getShipCount());
+    size_t countsAt = out.size();
+    AppendInt(out, 0); // removed count, patched below
+    AppendInt(out, 0); // changed count, patched below
+
+    int removed = 0;
+    int changed = 0;
+    // Removed IDs all come before the changed ships, which is the order Diff
+    // reports them in
+    Diff(*this, base,
+        [&](int id)
+        {
+            AppendInt(out, id);
+            removed++;
+        },
+        [&](const int* now, const int* then)
+        {
+            int mask = (1 << SHIP_INTS) - 1; // new, send everything
+            if(then)
+            {
+                mask = 0;
+                for(int f = 0; f < SHIP_INTS; f++)
+                {
+                    if(now[f] != then[f])
+                        mask |= 1 << f;
+                }
+            }
+            AppendInt(out, now[0]);
+            AppendInt(out, mask);
+            for(int f = 0; f < SHIP_INTS; f++)
+            {
+                if(mask & (1 << f))
+                    AppendInt(out, now[f]);
+            }
+            changed++;
+        });
+
+    int length = out.size() - start;
+    memcpy(&out[start + sizeof(char)], &length, sizeof(int));
+    memcpy(&out[countsAt], &removed, sizeof(int));
+    memcpy(&out[countsAt + sizeof(int)], &changed, sizeof(int));
+}
+
+void Snapshot::EncodePacked(const Snapshot* base, std::string& out) const
+{
+    // The counts lead the bitstream, so count first
+    int removed = 0;
+    int changed = 0;
+    Diff(*this, base,
+        [&](int) { removed++; },
+        [&](const int*, const int*) { changed++; });
+
+    size_t start = out.size();
+    out.push_back('Q');
+    AppendInt(out, 0); // length, patched below
+
+    BitWriter bits(out);
+    bits.WriteVar(sequence);
+    bits.WriteVar(base ? sequence - base->getSequence() : 0);
+    bits.WriteVar(getShipCount());
+    bits.WriteVar(removed);
+    bits.WriteVar(changed);
+
+    int lastRemoved = -1;
+    int lastChanged = -1;
+    Diff(*this, base,
+        [&](int id)
+        {
+            bits.WriteVar(id - lastRemoved - 1);
+            lastRemoved = id;
+        },
+        [&](const int* now, const int* then)
+        {
+            int mask = 0;
+            for(int f = 1; f < SHIP_INTS; f++)
+            {
+                if(then ? now[f] != then[f] : now[f] != 0)
+                    mask |= 1 << f;
+            }
+            bits.WriteVar(now[0] - lastChanged - 1);
+            lastChanged = now[0];
+
+            int cold = mask >> PACKED_HOT_FIELDS;
+            bits.Write((mask >> 1) & ((1 << (PACKED_HOT_FIELDS - 1)) - 1), PACKED_HOT_FIELDS - 1);
+            bits.Write(cold != 0, 1);
+            if(cold)
+                bits.Write(cold, PACKED_COLD_BITS);
+            for(int f = 1; f < SHIP_INTS; f++)
+            {
+                if(mask & (1 << f))
+                    WritePackedField(bits, f, now[f]);
+            }
+        });
+    bits.Flush();
+
+    int length = out.size() - start;
+    memcpy(&out[start + sizeof(char)], &length, sizeof(int));
+}
+
+// 'D' entries: whole ints, with the removed IDs in a block ahead of the rest
+class IntReader
+{
+private:
+    const char* message;
+    int size;
+    int index;
+    int removedAt;
+
+public:
+    int numRemoved;
+    int numChanged;
+
+    IntReader(const char* m, int s, int at, int r, int c)
+    {
+        message = m;
+        size = s;
+        removedAt = at;
+        numRemoved = r;
+        numChanged = c;
+        index = at + r * sizeof(int);
+    }
+
+    int Removed(int r)
+    {
+        int at = removedAt + r * sizeof(int);
+        return ReadInt(message, at);
+    }
+
+    bool NextChanged(int& id, int& mask)
+    {
+        if(index + 2 * (int)sizeof(int) > size)
+            return false;
+        id = ReadInt(message, index);
+        mask = ReadInt(message, index);
+        return true;
+    }
+
+    bool Field(int f, int& val)
+    {
+        if(index + (int)sizeof(int) > size)
+            return false;
+        val = ReadInt(message, index);
+        return true;
+    }
+};
+
+// 'Q' entries. The removed IDs are unpacked up front into removed, since the
+// merge looks them up as it goes
+class PackedReader
+{
+private:
+    BitReader& bits;
+    const std::vector<int>& removed;
+    int lastID;
+
+public:
+    int numRemoved;
+    int numChanged;
+
+    PackedReader(BitReader& b, const std::vector<int>& r, int c) : bits(b), removed(r)
+    {
+        lastID = -1;
+        numRemoved = r.size();
+        numChanged = c;
+    }
+
+    int Removed(int r)
+    {
+        return removed[r];
+    }
+
+    bool NextChanged(int& id, int& mask)
+    {
+        id = lastID + 1 + (int)bits.ReadVar();
+        lastID = id;
+        mask = bits.Read(PACKED_HOT_FIELDS - 1) << 1;
+        if(bits.Read(1))
+            mask |= bits.Read(PACKED_COLD_BITS) << PACKED_HOT_FIELDS;
+        return bits.ok();
+    }
+
+    bool Field(int f, int& val)
+    {
+        val = ReadPackedField(bits, f);
+        return bits.ok();
+    }
+};
+
+// Merge the baseline and the changed ships, both in ID order, leaving out
+// the removed ones (also in ID order)
+template<class Reader>
+bool Snapshot::Merge(const Snapshot* base, int numShips, Reader& reader)
+{
+    int baseShips = base ? base->getShipCount() : 0;
+    // numShips comes off the wire; the merge can't produce more than this
+    if(numShips > baseShips + reader.numChanged)
+        return false;
+
+    records.clear();
+    records.reserve(numShips * SHIP_INTS);
+    int b = 0;
+    int r = 0;
+    int lastID = -1;
+    for(int c = 0; c <= reader.numChanged; c++)
+    {
+        int id = -1;
+        int mask = 0;
+        if(c < reader.numChanged)
+        {
+            if(!reader.NextChanged(id, mask))
+                return false;
+            if(id <= lastID)
+                return false;
+            lastID = id;
+        }
+
+        // Unchanged baseline ships before this one (or all that are left)
+        for(; b < baseShips && (c == reader.numChanged || base->getRecord(b)[0] < id); b++)
+        {
+            int baseID = base->getRecord(b)[0];
+            int gone = -1;
+            while(r < reader.numRemoved)
+            {
+                gone = reader.Removed(r);
+                if(gone >= baseID)
+                    break;
+                r++;
+            }
+            if(r < reader.numRemoved && gone == baseID)
+                continue;
+            records.insert(records.end(), base->getRecord(b), base->getRecord(b) + SHIP_INTS);
+        }
+        if(c == reader.numChanged)
+            break;
+
+        size_t at = records.size();
+        if(b < baseShips && base->getRecord(b)[0] == id)
+        {
+            records.insert(records.end(), base->getRecord(b), base->getRecord(b) + SHIP_INTS);
+            b++;
+        }
+        else
+            records.resize(at + SHIP_INTS, 0);
+
+        int* rec = &records[at];
+        for(int f = 0; f < SHIP_INTS; f++)
+        {
+            if((mask & (1 << f)) && !reader.Field(f, rec[f]))
+                return false;
+        }
+        rec[0] = id;
+    }
+
+    return getShipCount() == numShips;
+}
+
+bool Snapshot::DecodeDelta(const char* message, int message_size, const Snapshot* base)
+{
+    if(message_size < (int)sizeof(char))
+        return false;
+    if(message[0] == 'Q')
+        return DecodePacked(message, message_size, base);
+    return DecodeInts(message, message_size, base);
+}
+
+bool Snapshot::DecodeInts(const char* message, int message_size, const Snapshot* base)
+{
+    if(message_size < (int)(sizeof(char) + DELTA_HEADER_INTS * sizeof(int)))
+        return false;
+
+    int index = sizeof(char) + sizeof(int);
+    int seq = ReadInt(message, index);
+    int baseSeq = ReadInt(message, index);
+    int numShips = ReadInt(message, index);
+    int numRemoved = ReadInt(message, index);
+    int numChanged = ReadInt(message, index);
+
+    if(baseSeq != -1 && (base == NULL || base->getSequence() != baseSeq))
+        return false;
+    if(numShips < 0 || numRemoved < 0 || numChanged < 0 || numShips > MAX_MESSAGE_SIZE / (int)sizeof(int))
+        return false;
+    if(numRemoved > (message_size - index) / (int)sizeof(int))
+        return false;
+    // Each changed ship has at least its ID and mask
+    if(numChanged > (message_size - index) / (2 * (int)sizeof(int)))
+        return false;
+
+    IntReader reader(message, message_size, index, numRemoved, numChanged);
+    if(!Merge(baseSeq != -1 ? base : NULL, numShips, reader))
+        return false;
+    sequence = seq;
+    return true;
+}
+
+bool Snapshot::DecodePacked(const char* message, int message_size, const Snapshot* base)
+{
+    int index = sizeof(char) + sizeof(int);
+    if(message_size < index)
+        return false;
+
+    BitReader bits(message + index, message_size - index);
+    int seq = bits.ReadVar();
+    int behind = bits.ReadVar();
+    int numShips = bits.ReadVar();
+    int numRemoved = bits.ReadVar();
+    int numChanged = bits.ReadVar();
+
+    if(!bits.ok() || seq < 0 || behind < 0 || numShips < 0 || numRemoved < 0 || numChanged < 0)
+        return false;
+    if(behind != 0 && (base == NULL || base->getSequence() != seq - behind))
+        return false;
+    // Every entry takes at least a few bits, so bigger counts are lies
+    if(numShips > MAX_MESSAGE_SIZE / (int)sizeof(int) || numRemoved > message_size * 2 || numChanged > message_size * 2)
+        return false;
+
+    removed.clear();
+    int lastID = -1;
+    for(int r = 0; r < numRemoved; r++)
+    {
+        lastID += 1 + (int)bits.ReadVar();
+        removed.push_back(lastID);
+    }
+    if(!bits.ok())
+        return false;
+
+    PackedReader reader(bits, removed, numChanged);
+    if(!Merge(behind != 0 ? base : NULL, numShips, reader))
+        return false;
+    sequence = seq;
+    return true;
+}
+
+int Snapshot::Sequence(const char* message)
+{
+    int index = sizeof(char) + sizeof(int);
+    if(message[0] == 'Q')
+    {
+        int length;
+        memcpy(&length, &message[sizeof(char)], sizeof(int));
+        BitReader bits(message + index, length - index);
+        return bits.ReadVar();
+    }
+    return ReadInt(message, index);
+}
+
+int Snapshot::BaseSequence(const char* message)
+{
+    int index = sizeof(char) + 2 * sizeof(int);
+    if(message[0] == 'Q')
+    {
+        int length;
+        memcpy(&length, &message[sizeof(char)], sizeof(int));
+        index = sizeof(char) + sizeof(int);
+        BitReader bits(message + index, length - index);
+        int seq = bits.ReadVar();
+        int behind = bits.ReadVar();
+        return behind == 0 ? -1 : seq - behind;
+    }
+    return ReadInt(message, index);
+}
@@ -0,0 +1,76 @@
+#include <vector>
+#include <string>
+#include "Ship.h"
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#define SNAPSHOT_HISTORY 32 // snapshots each side remembers for delta baselines
+
+// The ships one client could see at one broadcast, stored as flat wire
+// records sorted by ship ID. Ships without an ID (-1) are never included.
+// Snapshots are compared field by field to build 'D' (delta) messages that
+// only carry what changed since a snapshot the client has acknowledged.
+// Records are matched by ship ID, so ships can drop in and out of a client's
+// view between snapshots.
+//
+// 'D' layout, all ints:
+//   [char 'D'][length][sequence][base sequence, -1 = keyframe][ship count]
+//   [removed count][changed count]
+//   then the removed ship IDs, ascending
+//   then per changed or new ship, by ascending ID: [id][field mask][one int per set bit in the mask]
+//
+// 'Q' carries the same thing for clients on WIRE_VERSION_PACKED, as a
+// bitstream (see BitPack.h) after [char 'Q'][int length]:
+//   var sequence, var sequence - base (0 = keyframe), var ship count,
+//   var removed count, var changed count
+//   then the removed IDs as var gaps from the previous ID
+//   then per changed or new ship: var ID gap, 3 bits for x/y/orientation
+//   changed, 1 bit for anything else changed, and if set 14 bits for which,
+//   then each changed field packed to its range in ShipRecord.h.
+//   New ships only send their nonzero fields
+class Snapshot
+{
+private:
+    int sequence;
+    std::vector<int> records;   // SHIP_INTS ints per ship
+    std::vector<int> removed;   // scratch for decoding 'Q'
+
+    void Pack(std::vector<Ship*>& ships, const std::vector<int>* indices);
+
+    // Shared by both formats once the header is read
+    template<class Reader>
+    bool Merge(const Snapshot* base, int numShips, Reader& reader);
+    bool DecodeInts(const char* message, int message_size, const Snapshot* base);
+    bool DecodePacked(const char* message, int message_size, const Snapshot* base);
+
+public:
+    Snapshot();
+    Snapshot(int seq, std::vector<Ship*>& ships);
+    // Only the ships at the given indices of ships
+    Snapshot(int seq, std::vector<Ship*>& ships, const std::vector<int>& indices);
+
+    int getSequence() const;
+    void setSequence(int);
+
+    int getShipCount() const;
+    const int* getRecord(int i) const;
+
+    // Appends one new Ship per record
+    void ToShips(std::vector<Ship*>& ships) const;
+
+    // Appends a 'D' message for this snapshot relative to base, or a keyframe
+    // when base is NULL
+    void EncodeDelta(const Snapshot* base, std::string& out) const;
+    // The same as a 'Q' message
+    void EncodePacked(const Snapshot* base, std::string& out) const;
+
+    // Rebuilds this snapshot from a 'D' or 'Q' message. base must be the
+    // snapshot named by BaseSequence(), or NULL for a keyframe
+    bool DecodeDelta(const char* message, int message_size, const Snapshot* base);
+
+    static int BaseSequence(const char* message);
+    static int Sequence(const char* message);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <math.h>
+#include "SpriteAtlas.h"
+
+using namespace std;
+
+bool SpriteAtlas::Load(const vector<string>& paths)
+{
+    bool ok = true;
+    rects.clear();
+    vector<sf::Image> images;
+    vector<string> names;
+    unsigned int area = 0;
+    unsigned int widest = 0;
+    for(int i = 0; i < paths.size(); i++)
+    {
+        sf::Image image;
+        if(!image.loadFromFile(paths[i]))
+        {
+            cerr << "Could not load sprite " << paths[i] << "\n";
+            ok = false;
+            continue;
+        }
+        sf::Vector2u size = image.getSize();
+        area += (size.x + ATLAS_PADDING) * (size.y + ATLAS_PADDING);
+        if(size.x + ATLAS_PADDING > widest)
+            widest = size.x + ATLAS_PADDING;
+        images.push_back(image);
+        names.push_back(paths[i]);
+    }
+    if(images.empty())
+        return false;
+
+    // Shelves about as wide as the whole lot is tall, left to right and then
+    // down; the images are all much the same size, so this packs tightly
+    unsigned int width = max(widest, (unsigned int)ceil(sqrt((double)area)));
+    vector<sf::Vector2u> places;
+    unsigned int x = 0, y = 0, shelfHeight = 0;
+    for(int i = 0; i < images.size(); i++)
+    {
+        sf::Vector2u size = images[i].getSize();
+        if(x + size.x + ATLAS_PADDING > width)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        places.push_back(sf::Vector2u(x, y));
+        x += size.x + ATLAS_PADDING;
+        if(size.y + ATLAS_PADDING > shelfHeight)
+            shelfHeight = size.y + ATLAS_PADDING;
+    }
+
+    sf::Image atlas;
+    atlas.create(width, y + shelfHeight, sf::Color::Transparent);
+    for(int i = 0; i < images.size(); i++)
+    {
+        sf::Vector2u size = images[i].getSize();
+        atlas.copy(images[i], places[i].x, places[i].y);
+        rects[names[i]] = sf::IntRect(places[i].x, places[i].y, size.x, size.y);
+    }
+    if(!texture.loadFromImage(atlas))
+    {
+        cerr << "Could not make a " << width << "x" << y + shelfHeight << " sprite atlas\n";
+        rects.clear();
+        return false;
+    }
+    texture.setSmooth(true);
+    return ok;
+}
+
+sf::IntRect SpriteAtlas::getRect(const string& path) const
+{
+    auto found = rects.find(path);
+    if(found == rects.end())
+        return sf::IntRect();
+    return found->second;
+}
+
+const sf::Texture& SpriteAtlas::getTexture() const
+{
+    return texture;
+}
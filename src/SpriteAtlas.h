@@ -0,0 +1,30 @@
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#ifndef SPRITEATLAS_H
+#define SPRITEATLAS_H
+
+#define ATLAS_PADDING 1     // transparent pixels between images, so smoothing doesn't bleed
+
+// Several images packed into one texture, so everything drawn from them can
+// go out in a single draw call (see SpriteBatch). Each file is read and
+// decoded once, when the atlas is loaded; after that sprites only need the
+// texture and the rectangle their image ended up in.
+class SpriteAtlas
+{
+public:
+    // Packs every file in paths, shelf by shelf. False if any of them failed
+    // to load; the rest are still packed
+    bool Load(const std::vector<std::string>& paths);
+
+    // Where path is in the texture, an empty rectangle if it isn't
+    sf::IntRect getRect(const std::string& path) const;
+    const sf::Texture& getTexture() const;
+
+private:
+    sf::Texture texture;
+    std::unordered_map<std::string, sf::IntRect> rects;
+};
+#endif // !SPRITEATLAS_H
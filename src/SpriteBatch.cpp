@@ -0,0 +1,42 @@
+#include "SpriteBatch.h"
+
+SpriteBatch::SpriteBatch() : vertices(sf::Triangles)
+{
+}
+
+void SpriteBatch::Clear()
+{
+    vertices.clear();
+}
+
+void SpriteBatch::Add(const sf::Sprite& sprite)
+{
+    const sf::IntRect& rect = sprite.getTextureRect();
+    const sf::Transform& transform = sprite.getTransform();
+    float w = rect.width;
+    float h = rect.height;
+
+    sf::Vertex corners[4];
+    corners[0] = sf::Vertex(transform.transformPoint(0, 0), sf::Vector2f(rect.left, rect.top));
+    corners[1] = sf::Vertex(transform.transformPoint(w, 0), sf::Vector2f(rect.left + w, rect.top));
+    corners[2] = sf::Vertex(transform.transformPoint(w, h), sf::Vector2f(rect.left + w, rect.top + h));
+    corners[3] = sf::Vertex(transform.transformPoint(0, h), sf::Vector2f(rect.left, rect.top + h));
+
+    vertices.append(corners[0]);
+    vertices.append(corners[1]);
+    vertices.append(corners[2]);
+    vertices.append(corners[0]);
+    vertices.append(corners[2]);
+    vertices.append(corners[3]);
+}
+
+void SpriteBatch::Draw(sf::RenderTarget& target, const sf::Texture& texture)
+{
+    if(vertices.getVertexCount() > 0)
+        target.draw(vertices, &texture);
+}
+
+int SpriteBatch::getCount()
+{
+    return vertices.getVertexCount() / 6;
+}
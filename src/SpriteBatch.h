@@ -0,0 +1,25 @@
+#include <SFML/Graphics.hpp>
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+// Sprites that share one texture (an atlas, see SpriteAtlas) collected into a
+// single vertex array and drawn with one call, instead of one draw and one
+// texture switch per sprite. Each sprite is two triangles placed exactly as
+// drawing it would place it. Clear keeps the array's memory, so refilling it
+// every frame doesn't allocate.
+class SpriteBatch
+{
+public:
+    SpriteBatch();
+
+    void Clear();
+    void Add(const sf::Sprite& sprite);
+    void Draw(sf::RenderTarget& target, const sf::Texture& texture);
+
+    int getCount();
+
+private:
+    sf::VertexArray vertices;
+};
+#endif // !SPRITEBATCH_H
@@ -0,0 +1,59 @@
+#include <atomic>
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+// Hands whole states from one writer thread to one reader thread without
+// either ever waiting for the other. Of the three slots the writer owns one
+// (Back), the reader owns one (Front) and the third holds whatever was
+// published last. Publish swaps the writer's slot with that one and Acquire
+// swaps it with the reader's, each in a single atomic exchange, so the reader
+// always sees a complete state and the writer can publish as fast as it likes;
+// states the reader never got round to are written over.
+// Slots are reused, not cleared: the writer gets back one it published two
+// swaps ago (or one the reader had), and must bring it fully up to date.
+template<class T>
+class TripleBuffer
+{
+private:
+    static const int INDEX = 3;     // slot number in the low bits of middle...
+    static const int FRESH = 4;     // ...and whether the reader has seen it yet
+
+    T slots[3];
+    std::atomic<int> middle;
+    int back;       // writer's
+    int front;      // reader's
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2)
+    {
+    }
+
+    // Writer: the slot to fill in, then Publish it
+    T& Back()
+    {
+        return slots[back];
+    }
+
+    void Publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader: swaps in the newest published state, if there is one since the
+    // last call. Front stays the same slot otherwise
+    bool Acquire()
+    {
+        if(!(middle.load(std::memory_order_acquire) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    T& Front()
+    {
+        return slots[front];
+    }
+};
+
+#endif
@@ -0,0 +1,542 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "Protocol.h"
+#include "Worker.h"
+
+using namespace std;
+
+static char wakeTag;    // epoll data pointers for the eventfd and timerfd,
+static char tickTag;    // never dereferenced
+static char udpTag;
+static char reportTag;
+
+static int CreateTickTimer(int hz)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0)
+        return -1;
+
+    struct itimerspec spec;
+    long periodNs = 1000000000L / hz;
+    spec.it_interval.tv_sec = periodNs / 1000000000L;
+    spec.it_interval.tv_nsec = periodNs % 1000000000L;
+    spec.it_value = spec.it_interval;
+    if(timerfd_settime(fd, 0, &spec, NULL) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+Worker::Worker(int i, const ServerConfig& cfg)
+{
+    index = i;
+    config = cfg;
+    tickHz = config.tickHz;
+    tickTimer = -1;
+    stopping = false;
+    ticks = 0;
+    broadcasts = 0;
+    sends = 0;
+    totalUs = 0;
+    maxUs = 0;
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(wakeFd < 0 || !loop.Add(wakeFd, EPOLLIN | EPOLLET, &wakeTag))
+        perror("eventfd");
+
+    if(tickHz > 0)
+    {
+        tickTimer = CreateTickTimer(tickHz);
+        if(tickTimer < 0 || !loop.Add(tickTimer, EPOLLIN | EPOLLET, &tickTag))
+            perror("timerfd");
+    }
+
+    reportTimer = -1;
+    if(config.metricsPort > 0)
+    {
+        reportTimer = CreateTickTimer(1);
+        if(reportTimer < 0 || !loop.Add(reportTimer, EPOLLIN | EPOLLET, &reportTag))
+            perror("timerfd");
+        RegisterMetrics();
+    }
+
+    // Each worker gets its own UDP port, so datagrams land on the thread
+    // that owns the client without any hand-off
+    udpSd = -1;
+    udpPort = 0;
+    random.seed(random_device()());
+    if(config.udp)
+    {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = 0;
+        udpSd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(udpSd < 0 || bind(udpSd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+            || getsockname(udpSd, (struct sockaddr*)&addr, &len) < 0
+            || !loop.Add(udpSd, EPOLLIN | EPOLLET, &udpTag))
+        {
+            perror("udp socket");
+            if(udpSd >= 0)
+                close(udpSd);
+            udpSd = -1;
+        }
+        else
+            udpPort = ntohs(addr.sin_port);
+    }
+}
+
+Worker::~Worker()
+{
+    if(thread.joinable())
+    {
+        stopping = true;
+        uint64_t one = 1;
+        if(write(wakeFd, &one, sizeof(one)) < 0)
+            perror("eventfd write");
+        thread.join();
+    }
+    // Adopted but never taken in; their sessions are ours all the same
+    for(int i = 0; i < inbox.size(); i++)
+    {
+        if(find(sessions.begin(), sessions.end(), inbox[i].second) == sessions.end())
+            sessions.push_back(inbox[i].second);
+        delete inbox[i].first;
+    }
+    for(auto it = connections.begin(); it != connections.end(); ++it)
+        delete it->second;
+    for(int i = 0; i < sessions.size(); i++)
+        delete sessions[i];
+    if(tickTimer >= 0)
+        close(tickTimer);
+    if(reportTimer >= 0)
+        close(reportTimer);
+    if(udpSd >= 0)
+        close(udpSd);
+    if(wakeFd >= 0)
+        close(wakeFd);
+}
+
+void Worker::Start()
+{
+    thread = std::thread(&Worker::Run, this);
+}
+
+int Worker::getIndex()
+{
+    return index;
+}
+
+WorkerMetrics& Worker::getMetrics()
+{
+    return metrics;
+}
+
+void Worker::Adopt(Connection* conn, Session* session)
+{
+    {
+        lock_guard<mutex> guard(inboxLock);
+        inbox.push_back(make_pair(conn, session));
+    }
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) < 0)
+        perror("eventfd write");
+}
+
+void Worker::CloseLater(Connection* conn)
+{
+    if(conn->isClosing())
+        return;
+    conn->setClosing(true);
+    dropped.push_back(conn);
+}
+
+void Worker::Run()
+{
+    while(!stopping)
+    {
+        int activity = loop.Wait(-1);
+        ScopedTimer batch(metrics.batchUs);
+        for(int e = 0; e < activity; e++)
+        {
+            void* data = loop.getData(e);
+            if(data == &wakeTag)
+            {
+                uint64_t count;
+                while(read(wakeFd, &count, sizeof(count)) > 0)
+                    ;
+                TakeInbox();
+                continue;
+            }
+            if(data == &udpTag)
+            {
+                ReadDatagrams();
+                continue;
+            }
+            if(data == &tickTag)
+            {
+                uint64_t expirations;
+                while(read(tickTimer, &expirations, sizeof(expirations)) > 0)
+                    ;
+                Tick();
+                continue;
+            }
+            if(data == &reportTag)
+            {
+                uint64_t expirations;
+                while(read(reportTimer, &expirations, sizeof(expirations)) > 0)
+                    ;
+                Report();
+                continue;
+            }
+
+            Connection* conn = (Connection*)data;
+            unsigned int events = loop.getEvents(e);
+            if(conn->isClosing())
+                continue;
+
+            //the kernel has room again, push out whatever was queued
+            if(events & EPOLLOUT)
+            {
+                if(!conn->Flush())
+                    CloseLater(conn);
+            }
+            if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                ReadConnection(conn);
+        }
+        SweepDropped();
+    }
+}
+
+void Worker::TakeInbox()
+{
+    vector< pair<Connection*, Session*> > arrived;
+    {
+        lock_guard<mutex> guard(inboxLock);
+        arrived.swap(inbox);
+    }
+
+    for(int i = 0; i < arrived.size(); i++)
+    {
+        Connection* conn = arrived[i].first;
+        Session* session = arrived[i].second;
+
+        bool known = false;
+        for(int s = 0; s < sessions.size() && !known; s++)
+            known = (sessions[s] == session);
+        if(!known)
+        {
+            sessions.push_back(session);
+            metrics.sessions.Set(sessions.size());
+        }
+
+        conn->setSession(session);
+        conn->setSentCounter(&metrics.bytesOut);
+        if(!loop.Add(conn->getSocket(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, conn))
+        {
+            perror("epoll_ctl");
+            delete conn;
+            continue;
+        }
+        connections[conn->getSocket()] = conn;
+        metrics.joins.Add();
+        metrics.clients.Add(1);
+        session->Join(conn);
+
+        // Bytes that came in behind the handshake are already buffered, and the
+        // edge that announced them was consumed by the acceptor
+        ProcessInbound(conn);
+        ReadConnection(conn);
+    }
+}
+
+//Edge triggered, so keep reading until the kernel has nothing left for us
+void Worker::ReadConnection(Connection* conn)
+{
+    RingBuffer& inbound = conn->getInbound();
+    while(!conn->isClosing())
+    {
+        int valread = inbound.ReadFrom(conn->getSocket());
+        if(valread < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                CloseLater(conn);
+            break;
+        }
+        if(valread == 0)
+        {
+            CloseLater(conn);
+            break;
+        }
+        conn->CountReceived(valread);
+        metrics.bytesIn.Add(valread);
+        ProcessInbound(conn);
+    }
+}
+
+//a read can hold several messages, or only part of one; anything
+//incomplete stays in the ring until the rest arrives
+void Worker::ProcessInbound(Connection* conn)
+{
+    RingBuffer& inbound = conn->getInbound();
+    int length = 0;
+    const char* msg;
+    while(!conn->isClosing() && (msg = Protocol::NextMessage(inbound, length)) != NULL)
+    {
+        conn->getSession()->HandleMessage(conn, msg, length);
+        inbound.Consume(length);
+        metrics.messagesIn.Add();
+    }
+    if(length < 0)
+    {
+        cerr << "Malformed message from client " << conn->getClientID() << ", dropping it\n";
+        CloseLater(conn);
+    }
+}
+
+int Worker::OpenUdp(Connection* conn)
+{
+    if(udpSd < 0)
+        return -1;
+    if(conn->getUdpToken() >= 0)
+        return conn->getUdpToken();
+
+    // Random so nobody can guess their way into another client's snapshots
+    int token;
+    do
+        token = random() & 0x7fffffff;
+    while(udpClients.count(token) > 0);
+    udpClients[token] = conn;
+    conn->setUdpToken(token);
+    return token;
+}
+
+int Worker::getUdpPort()
+{
+    return udpPort;
+}
+
+void Worker::SendDatagram(Connection* conn, const SharedBuffer& message)
+{
+    if(config.udpDropPercent > 0 && (int)(random() % 100) < config.udpDropPercent)
+        return;
+    const struct sockaddr_in& to = conn->getUdpAddress();
+    if(sendto(udpSd, message->data(), message->size(), 0, (const struct sockaddr*)&to, sizeof(to)) == (ssize_t)message->size())
+    {
+        conn->CountDatagram(message->size());
+        metrics.datagramsOut.Add();
+        metrics.datagramBytesOut.Add(message->size());
+    }
+}
+
+// Datagrams from clients: 'U' [token] says hello from the address snapshots
+// should go to, 'A' [token][sequence] acknowledges a snapshot
+void Worker::ReadDatagrams()
+{
+    char buf[sizeof(char) + 2 * sizeof(int)];
+    while(true)
+    {
+        struct sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t got = recvfrom(udpSd, buf, sizeof(buf), 0, (struct sockaddr*)&from, &len);
+        if(got < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(got < (ssize_t)(sizeof(char) + sizeof(int)))
+            continue;
+
+        int token;
+        memcpy(&token, &buf[sizeof(char)], sizeof(int));
+        auto it = udpClients.find(token);
+        if(it == udpClients.end() || it->second->isClosing())
+            continue;
+        Connection* conn = it->second;
+
+        if(buf[0] == 'U')
+            conn->BindUdp(from);
+        else if(buf[0] == 'A' && got == sizeof(buf))
+        {
+            int sequence;
+            memcpy(&sequence, &buf[sizeof(char) + sizeof(int)], sizeof(int));
+            conn->Acknowledge(sequence);
+        }
+    }
+}
+
+// One simulation tick for every session on this worker. Prints how long
+// ticks took once a second
+void Worker::Tick()
+{
+    auto start = chrono::steady_clock::now();
+    for(int i = 0; i < sessions.size(); i++)
+    {
+        int sent = sessions[i]->Tick();
+        if(sent > 0)
+        {
+            broadcasts++;
+            sends += sent;
+        }
+    }
+    SweepDropped();
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    metrics.tickUs.Observe(us);
+
+    ticks++;
+    totalUs += us;
+    if(us > maxUs)
+        maxUs = us;
+
+    if(ticks >= tickHz)
+    {
+        if(!sessions.empty())
+        {
+            long queued = 0;
+            long mostQueued = 0;
+            long skipped = 0;
+            int slow = 0;
+            for(auto it = connections.begin(); it != connections.end(); ++it)
+            {
+                long pending = it->second->getPendingBytes();
+                queued += pending;
+                if(pending > mostQueued)
+                    mostQueued = pending;
+                if(pending > config.slowClientBytes)
+                    slow++;
+                skipped += it->second->getSkippedSnapshots();
+            }
+            fprintf(stderr, "worker %d tick: %d sessions, %d ticks, %d broadcasts, %ld sends, avg %.1f us, max %.1f us (budget %d us)\n",
+                index, (int)sessions.size(), ticks, broadcasts, sends, totalUs / ticks, maxUs, 1000000 / tickHz);
+            fprintf(stderr, "worker %d queues: %ld bytes queued, %ld most on one client, %d slow clients, %ld snapshots skipped\n",
+                index, queued, mostQueued, slow, skipped);
+        }
+        ticks = 0;
+        broadcasts = 0;
+        sends = 0;
+        totalUs = 0;
+        maxUs = 0;
+    }
+}
+
+//Close anything that hung up or failed. Deferred so a Connection is never
+//freed while a later event in the same batch points at it
+void Worker::SweepDropped()
+{
+    for(int i = 0; i < dropped.size(); i++)
+    {
+        //Somebody disconnected , get his OR HER details and print
+        printf("Host disconnected , ip %s , port %d \n" , dropped[i]->getIp() , dropped[i]->getPort());
+        connections.erase(dropped[i]->getSocket());
+        if(dropped[i]->getUdpToken() >= 0)
+            udpClients.erase(dropped[i]->getUdpToken());
+        dropped[i]->getSession()->Leave(dropped[i]);
+        loop.Remove(dropped[i]->getSocket());
+        delete dropped[i];
+        metrics.disconnects.Add();
+        metrics.clients.Add(-1);
+    }
+    dropped.clear();
+}
+
+// Gauges that are cheaper to add up once a second than to keep current
+void Worker::Report()
+{
+    long ships = 0;
+    for(int i = 0; i < sessions.size(); i++)
+        ships += sessions[i]->getShipCount();
+    metrics.ships.Set(ships);
+
+    long queued = 0;
+    for(auto it = connections.begin(); it != connections.end(); ++it)
+        queued += it->second->getPendingBytes();
+    metrics.queuedBytes.Set(queued);
+
+    if(!config.metricsPerClient)
+        return;
+    vector<ClientMetrics> current;
+    current.reserve(connections.size());
+    for(auto it = connections.begin(); it != connections.end(); ++it)
+    {
+        Connection* conn = it->second;
+        ClientMetrics c;
+        c.session = conn->getSession()->getID();
+        c.clientID = conn->getClientID();
+        c.bytesIn = conn->getBytesReceived();
+        c.bytesOut = conn->getBytesSent() + conn->getDatagramBytesSent();
+        c.queuedBytes = conn->getPendingBytes();
+        c.projectileBytes = conn->getProjectileBytes();
+        current.push_back(c);
+    }
+    lock_guard<mutex> guard(clientMetricsLock);
+    clientMetrics.swap(current);
+}
+
+void Worker::RegisterMetrics()
+{
+    MetricsRegistry& registry = Metrics();
+    string w = "worker=\"" + to_string(index) + "\"";
+
+    registry.Register("starfleet_joins_total", "Clients that joined a session", w, &metrics.joins);
+    registry.Register("starfleet_disconnects_total", "Clients that left or were dropped", w, &metrics.disconnects);
+    registry.Register("starfleet_messages_in_total", "Messages received from clients", w, &metrics.messagesIn);
+    registry.Register("starfleet_bytes_in_total", "Bytes received from clients", w, &metrics.bytesIn);
+    registry.Register("starfleet_bytes_out_total", "Bytes sent to clients", w + ",transport=\"tcp\"", &metrics.bytesOut);
+    registry.Register("starfleet_bytes_out_total", "Bytes sent to clients", w + ",transport=\"udp\"", &metrics.datagramBytesOut);
+    registry.Register("starfleet_datagrams_out_total", "Snapshot datagrams sent", w, &metrics.datagramsOut);
+    registry.Register("starfleet_snapshots_total", "Snapshots broadcast", w, &metrics.snapshots);
+    registry.Register("starfleet_snapshot_sends_total", "Snapshots queued or sent to a client", w, &metrics.snapshotSends);
+    registry.Register("starfleet_snapshots_skipped_total", "Snapshots not sent because the client was behind", w, &metrics.snapshotsSkipped);
+    registry.Register("starfleet_slow_client_drops_total", "Clients dropped for not reading", w, &metrics.slowDrops);
+    registry.Register("starfleet_projectile_sends_total", "Projectile bursts queued to a client", w, &metrics.projectileSends);
+    registry.Register("starfleet_projectiles_skipped_total", "Projectile bursts not sent because the client was behind", w, &metrics.projectilesSkipped);
+
+    registry.Register("starfleet_clients", "Connected clients", w, &metrics.clients);
+    registry.Register("starfleet_sessions", "Sessions running", w, &metrics.sessions);
+    registry.Register("starfleet_ships", "Ships in the master lists", w, &metrics.ships);
+    registry.Register("starfleet_queued_bytes", "Bytes waiting for slow sockets", w, &metrics.queuedBytes);
+
+    registry.Register("starfleet_parse_microseconds", "Parsing one ship message", w, &metrics.parseUs);
+    registry.Register("starfleet_encode_microseconds", "Encoding one snapshot delta", w, &metrics.encodeUs);
+    registry.Register("starfleet_send_microseconds", "Sending one snapshot to one client", w, &metrics.sendUs);
+    registry.Register("starfleet_broadcast_microseconds", "One snapshot broadcast to a whole session", w, &metrics.broadcastUs);
+    registry.Register("starfleet_tick_microseconds", "One tick of every session on the worker", w, &metrics.tickUs);
+    registry.Register("starfleet_batch_microseconds", "Handling the events of one epoll wait", w, &metrics.batchUs);
+
+    if(!config.metricsPerClient)
+        return;
+    auto perClient = [this, w](long ClientMetrics::*field)
+    {
+        return [this, w, field](const string& name, string& out)
+        {
+            lock_guard<mutex> guard(clientMetricsLock);
+            char line[256];
+            for(int i = 0; i < clientMetrics.size(); i++)
+            {
+                const ClientMetrics& c = clientMetrics[i];
+                snprintf(line, sizeof(line), "%s{%s,session=\"%d\",client=\"%d\"} %ld\n",
+                    name.c_str(), w.c_str(), c.session, c.clientID, c.*field);
+                out += line;
+            }
+        };
+    };
+    registry.AddCollector("starfleet_client_bytes_in", "Bytes received from one client", "gauge", perClient(&ClientMetrics::bytesIn));
+    registry.AddCollector("starfleet_client_bytes_out", "Bytes sent to one client", "gauge", perClient(&ClientMetrics::bytesOut));
+    registry.AddCollector("starfleet_client_queued_bytes", "Bytes waiting for one client", "gauge", perClient(&ClientMetrics::queuedBytes));
+    registry.AddCollector("starfleet_client_projectile_bytes_out", "Projectile bytes queued to one client", "gauge", perClient(&ClientMetrics::projectileBytes));
+}
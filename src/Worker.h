@@ -0,0 +1,135 @@
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <random>
+#include "EventLoop.h"
+#include "Connection.h"
+#include "Session.h"
+#include "ServerConfig.h"
+#include "Metrics.h"
+
+#ifndef WORKER_H
+#define WORKER_H
+
+// What one worker exports, all labelled with worker="N". Only the worker
+// thread writes these; the metrics page reads them from its own thread
+struct WorkerMetrics
+{
+    Counter joins;
+    Counter disconnects;
+    Counter messagesIn;
+    Counter bytesIn;
+    Counter bytesOut;           // TCP
+    Counter datagramBytesOut;
+    Counter datagramsOut;
+    Counter snapshots;          // broadcasts
+    Counter snapshotSends;      // one per client per broadcast
+    Counter snapshotsSkipped;   // client too far behind
+    Counter slowDrops;          // disconnected for not reading
+    Counter projectileSends;    // 'P' bursts queued to a client
+    Counter projectilesSkipped; // 'P' bursts not queued because the client was behind
+
+    Gauge clients;
+    Gauge sessions;
+    Gauge ships;
+    Gauge queuedBytes;
+
+    Histogram parseUs;          // one 'S' message
+    Histogram encodeUs;         // one delta
+    Histogram sendUs;           // queueing and writing one snapshot to one client
+    Histogram broadcastUs;      // one whole broadcast
+    Histogram tickUs;
+    Histogram batchUs;          // handling everything one epoll wait returned
+};
+
+// Per-client numbers, copied out by the worker once a second for the
+// metrics page when --metrics-per-client is on
+struct ClientMetrics
+{
+    int session;
+    int clientID;
+    long bytesIn;
+    long bytesOut;
+    long queuedBytes;
+    long projectileBytes;
+};
+
+// One server thread with its own epoll loop and tick timer. It runs every
+// Session assigned to it and does all I/O for those sessions' clients.
+// The only way in from another thread is Adopt(), which queues a freshly
+// handshaken connection and wakes the loop through an eventfd.
+class Worker
+{
+private:
+    int index;
+    int tickHz;
+    ServerConfig config;
+
+    EventLoop loop;
+    int wakeFd;                 // eventfd, poked when the inbox has something
+    int tickTimer;              // timerfd, -1 when not ticking
+    int reportTimer;            // timerfd, once a second, refreshes the gauges
+    int udpSd;                  // snapshot datagrams, -1 when UDP is off
+    int udpPort;
+
+    std::unordered_map<int, Connection*> udpClients;    // keyed by hello token
+    std::mt19937 random;
+
+    std::thread thread;
+    std::atomic<bool> stopping; // set by the destructor, seen by the loop on its next wake
+    std::mutex inboxLock;
+    std::vector< std::pair<Connection*, Session*> > inbox;
+
+    std::vector<Session*> sessions;
+    std::unordered_map<int, Connection*> connections;   // keyed by socket
+    std::vector<Connection*> dropped;   // closed since the last sweep
+
+    WorkerMetrics metrics;
+    std::mutex clientMetricsLock;
+    std::vector<ClientMetrics> clientMetrics;
+
+    // tick timing, reported once a second
+    int ticks;
+    int broadcasts;
+    long sends;
+    double totalUs;
+    double maxUs;
+
+    void Run();
+    void TakeInbox();
+    void Tick();
+    void ReadConnection(Connection* conn);
+    void ProcessInbound(Connection* conn);
+    void SweepDropped();
+    void Report();
+    void RegisterMetrics();
+
+public:
+    Worker(int index, const ServerConfig& config);
+    // Stops the loop and waits for the thread before freeing what it used
+    ~Worker();
+
+    void Start();
+    int getIndex();
+    WorkerMetrics& getMetrics();
+
+    // Thread safe. The worker registers the socket with its own loop, joins
+    // the session and handles anything already sitting in the inbound ring
+    void Adopt(Connection* conn, Session* session);
+
+    // Worker thread only
+    void CloseLater(Connection* conn);
+
+    // Gives conn a token to say hello with over UDP and returns it, or -1 if
+    // UDP is off. Snapshots go by datagram once the hello has arrived
+    int OpenUdp(Connection* conn);
+    int getUdpPort();
+    void ReadDatagrams();
+    // Fire and forget; a lost snapshot is superseded by the next one
+    void SendDatagram(Connection* conn, const SharedBuffer& message);
+};
+
+#endif